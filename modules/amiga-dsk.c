@@ -1299,11 +1299,17 @@ static int de_identify_amiga_dms(deark *c)
 	return 85;
 }
 
+static const struct deark_module_sig amiga_dms_sigs[] = {
+	{ 0, "DMS!", 4, 0 }
+};
+
 void de_module_amiga_dms(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "amiga_dms";
 	mi->desc = "Amiga DMS disk image";
 	mi->run_fn = de_run_amiga_dms;
 	mi->identify_fn = de_identify_amiga_dms;
+	mi->sigs = amiga_dms_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(amiga_dms_sigs);
 	mi->flags |= DE_MODFLAG_NONWORKING;
 }
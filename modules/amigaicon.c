@@ -818,17 +818,15 @@ static void de_run_amigaicon(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_amigaicon(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xe3\x10", 2))
-		return 90;
-	return 0;
-}
+static const struct deark_module_sig amigaicon_sigs[] = {
+	{ 0, "\xe3\x10", 2, 90 }
+};
 
 void de_module_amigaicon(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "amigaicon";
 	mi->desc = "Amiga Workbench icon (.info), NewIcons, GlowIcons";
 	mi->run_fn = de_run_amigaicon;
-	mi->identify_fn = de_identify_amigaicon;
+	mi->sigs = amigaicon_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(amigaicon_sigs);
 }
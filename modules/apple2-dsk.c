@@ -213,6 +213,10 @@ static int de_identify_woz(deark *c)
 	return 100;
 }
 
+static const struct deark_module_sig woz_sigs[] = {
+	{ 0, "WOZ", 3, 0 }
+};
+
 void de_module_woz(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "woz";
@@ -220,4 +224,6 @@ void de_module_woz(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "metadata only";
 	mi->run_fn = de_run_woz;
 	mi->identify_fn = de_identify_woz;
+	mi->sigs = woz_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(woz_sigs);
 }
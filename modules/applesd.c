@@ -467,15 +467,10 @@ static void de_run_applesd(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_applesd(deark *c)
-{
-	i64 n;
-
-	n = de_getu32be(0);
-	if(n==0x00051607) return 100; // AppleDouble
-	if(n==0x00051600) return 100; // AppleSingle
-	return 0;
-}
+static const struct deark_module_sig applesd_sigs[] = {
+	{ 0, "\x00\x05\x16\x07", 4, 100 },
+	{ 0, "\x00\x05\x16\x00", 4, 100 }
+};
 
 static void de_help_applesd(deark *c)
 {
@@ -492,6 +487,7 @@ void de_module_applesd(deark *c, struct deark_module_info *mi)
 	mi->id_alias[1] = "appledouble";
 	mi->desc = "AppleSingle/AppleDouble";
 	mi->run_fn = de_run_applesd;
-	mi->identify_fn = de_identify_applesd;
+	mi->sigs = applesd_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(applesd_sigs);
 	mi->help_fn = de_help_applesd;
 }
@@ -468,7 +468,12 @@ static void do_extract_member_file(deark *c, lctx *d, struct member_data *md,
 		goto done;
 	}
 
+	fi->len_known = 1;
+	fi->len = md->orig_size;
 	outf = dbuf_create_output_file(c, NULL, fi, 0x0);
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)d->crco);
 	de_crcobj_reset(d->crco);
@@ -161,7 +161,12 @@ static void do_arcfs_extract_member_file(deark *c, lctx *d, struct arcfs_member_
 
 	de_finfo_set_name_from_ucstring(c, fi, fullfn, DE_SNFLAG_FULLPATH);
 
+	fi->len_known = 1;
+	fi->len = md->orig_len;
 	outf = dbuf_create_output_file(c, NULL, fi, 0x0);
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)d->crco);
 	de_crcobj_reset(d->crco);
@@ -412,12 +417,9 @@ done:
 	}
 }
 
-static int de_identify_arcfs(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "Archive\x00", 8))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig arcfs_sigs[] = {
+	{ 0, "Archive\x00", 8, 100 }
+};
 
 static void de_help_arcfs(deark *c)
 {
@@ -429,7 +431,8 @@ void de_module_arcfs(deark *c, struct deark_module_info *mi)
 	mi->id = "arcfs";
 	mi->desc = "ArcFS (RISC OS archive)";
 	mi->run_fn = de_run_arcfs;
-	mi->identify_fn = de_identify_arcfs;
+	mi->sigs = arcfs_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(arcfs_sigs);
 	mi->help_fn = de_help_arcfs;
 }
 
@@ -530,17 +533,15 @@ static void de_run_squash(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_squash(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "SQSH", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig squash_sigs[] = {
+	{ 0, "SQSH", 4, 100 }
+};
 
 void de_module_squash(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "squash";
 	mi->desc = "Squash (RISC OS compressed file)";
 	mi->run_fn = de_run_squash;
-	mi->identify_fn = de_identify_squash;
+	mi->sigs = squash_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(squash_sigs);
 }
@@ -403,19 +403,17 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_prismpaint(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PNT\x00", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig prismpaint_sigs[] = {
+	{ 0, "PNT\x00", 4, 100 }
+};
 
 void de_module_prismpaint(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "prismpaint";
 	mi->desc = "Atari Prism Paint .PNT, a.k.a. TruePaint .TPI";
 	mi->run_fn = de_run_prismpaint;
-	mi->identify_fn = de_identify_prismpaint;
+	mi->sigs = prismpaint_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(prismpaint_sigs);
 }
 
 // **************************************************************************
@@ -532,20 +530,17 @@ static void de_run_indypaint(deark *c, de_module_params *mparams)
 	de_free(c, adata);
 }
 
-static int de_identify_indypaint(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "Indy", 4)) {
-		return 70;
-	}
-	return 0;
-}
+static const struct deark_module_sig indypaint_sigs[] = {
+	{ 0, "Indy", 4, 70 }
+};
 
 void de_module_indypaint(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "indypaint";
 	mi->desc = "Atari IndyPaint .TRU";
 	mi->run_fn = de_run_indypaint;
-	mi->identify_fn = de_identify_indypaint;
+	mi->sigs = indypaint_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(indypaint_sigs);
 }
 
 // **************************************************************************
@@ -743,9 +738,11 @@ static void do_tinystuff_1bpp(deark *c, tinyctx *d, struct atari_img_decode_data
 static void do_tinystuff_2or4bpp(deark *c, tinyctx *d, struct atari_img_decode_data *adata)
 {
 	i64 x, y;
-	i64 pos = 0;
 	i64 width;
 	UI bpp;
+	u8 rawbuf[160];
+	u8 planebuf[16];
+	u8 idxbuf[640];
 
 	bpp = (UI)adata->bpp;
 	if(bpp!=2 && bpp!=4) return;
@@ -754,26 +751,25 @@ static void do_tinystuff_2or4bpp(deark *c, tinyctx *d, struct atari_img_decode_d
 	else width = 320;
 
 	for(y=0; y<200; y++) {
+		// Each row is 160 bytes.
+		// 2bpp: Every 2 words (4 bytes; 32 bits) makes 16 pixels
+		// 4bpp: Every 4 words (8 bytes; 64 bits) makes 16 pixels
+		dbuf_read(adata->unc_pixels, rawbuf, y*160, 160);
+		de_zeromem(idxbuf, sizeof(idxbuf));
+
 		for(x=0; x<width; x+=16) {
-			UI n[4];
 			UI b_idx;
 			UI k;
 
-			// 2bpp: Every 2 words (4 bytes; 32 bits) makes 16 pixels
-			// 4bpp: Every 4 words (8 bytes; 64 bits) makes 16 pixels
 			for(b_idx=0; b_idx<bpp; b_idx++) {
-				n[b_idx] = (UI)dbuf_getu16be_p(adata->unc_pixels, &pos);
-			}
-
-			for(k=0; k<16; k++) {
-				UI v = 0;
-
-				for(b_idx=0; b_idx<bpp; b_idx++) {
-					if(n[b_idx]&(1U<<(15-k))) v += (1U<<b_idx);
+				de_unpack_pixels(&rawbuf[(x/16)*bpp*2 + b_idx*2], 1, 16, planebuf, 0);
+				for(k=0; k<16; k++) {
+					idxbuf[x+k] |= (u8)(planebuf[k]<<b_idx);
 				}
-				de_bitmap_setpixel_rgb(adata->img, x+(i64)k, y, adata->pal[v]);
 			}
 		}
+
+		de_bitmap_setpixels_paletted(adata->img, 0, y, width, idxbuf, adata->pal);
 	}
 }
 
@@ -1131,20 +1127,17 @@ done:
 	de_free(c, adata);
 }
 
-static int de_identify_neochrome_ani(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xba\xbe\xeb\xea", 4)) {
-		return 100;
-	}
-	return 0;
-}
+static const struct deark_module_sig neochrome_ani_sigs[] = {
+	{ 0, "\xba\xbe\xeb\xea", 4, 100 }
+};
 
 void de_module_neochrome_ani(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "neochrome_ani";
 	mi->desc = "NEOchrome Animation";
 	mi->run_fn = de_run_neochrome_ani;
-	mi->identify_fn = de_identify_neochrome_ani;
+	mi->sigs = neochrome_ani_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(neochrome_ani_sigs);
 	mi->flags |= DE_MODFLAG_NONWORKING;
 }
 
@@ -1206,13 +1199,9 @@ done:
 	de_free(c, adata);
 }
 
-static int de_identify_animatic(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 48, "\x27\x18\x28\x18", 4)) {
-		return 100;
-	}
-	return 0;
-}
+static const struct deark_module_sig animatic_sigs[] = {
+	{ 48, "\x27\x18\x28\x18", 4, 100 }
+};
 
 static void de_help_animatic(deark *c)
 {
@@ -1224,7 +1213,8 @@ void de_module_animatic(deark *c, struct deark_module_info *mi)
 	mi->id = "animatic";
 	mi->desc = "Animatic Film";
 	mi->run_fn = de_run_animatic;
-	mi->identify_fn = de_identify_animatic;
+	mi->sigs = animatic_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(animatic_sigs);
 	mi->help_fn = de_help_animatic;
 }
 
@@ -1235,8 +1225,11 @@ void de_module_animatic(deark *c, struct deark_module_info *mi)
 static void decode_falcon_8bit_image(deark *c, struct atari_img_decode_data *adata, i64 pos)
 {
 	i64 i, j, k;
-	unsigned int v;
-	unsigned int n;
+	i64 n;
+	i64 rowspan;
+	u8 *rawbuf = NULL;
+	u8 *planebuf = NULL;
+	u8 *idxbuf = NULL;
 	de_finfo *fi = NULL;
 
 	adata->img = de_bitmap_create(c, adata->w, adata->h, 3);
@@ -1248,21 +1241,38 @@ static void decode_falcon_8bit_image(deark *c, struct atari_img_decode_data *ada
 		fi->density.ydens = 200.0;
 	}
 
+	if(!de_good_image_dimensions_noerr(c, adata->w, adata->h)) goto done;
+	// Each row has adata->w bytes: for every 16 pixels, one 16-bit word for
+	// each of the 8 planes.
+	rowspan = de_pad_to_n(adata->w, 16);
+	rawbuf = de_malloc(c, rowspan);
+	planebuf = de_malloc(c, rowspan);
+	idxbuf = de_malloc(c, rowspan);
+
 	for(j=0; j<adata->h; j++) {
-		for(i=0; i<adata->w; i++) {
-			v = 0;
+		dbuf_read(c->infile, rawbuf, pos+j*adata->w, rowspan);
+		de_zeromem(idxbuf, (size_t)rowspan);
+
+		for(i=0; i<rowspan; i+=16) {
 			for(k=0; k<8; k++) {
-				n = (u32)de_getu16be(pos+j*adata->w + (i-i%16) +2*k);
-				if(n&(1<<(15-i%16))) v |= 1<<k;
+				de_unpack_pixels(&rawbuf[i+2*k], 1, 16, planebuf, 0);
+				for(n=0; n<16; n++) {
+					idxbuf[i+n] |= (u8)(planebuf[n]<<k);
+				}
 			}
-			de_bitmap_setpixel_rgb(adata->img, i, j, adata->pal[v]);
 		}
+
+		de_bitmap_setpixels_paletted(adata->img, 0, j, adata->w, idxbuf, adata->pal);
 	}
 
+done:
 	de_bitmap_write_to_file_finfo(adata->img, fi, 0);
 	de_bitmap_destroy(adata->img);
 	adata->img = NULL;
 	de_finfo_destroy(c, fi);
+	de_free(c, rawbuf);
+	de_free(c, planebuf);
+	de_free(c, idxbuf);
 }
 
 static void do_atari_falcon_8bit_img(deark *c, i64 width, i64 height)
@@ -1477,18 +1487,15 @@ static void de_run_coke(deark *c, de_module_params *mparams)
 	de_finfo_destroy(c, fi);
 }
 
-static int de_identify_coke(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, (const void*)"COKE format.", 12)) {
-		return 100;
-	}
-	return 0;
-}
+static const struct deark_module_sig coke_sigs[] = {
+	{ 0, "COKE format.", 12, 100 }
+};
 
 void de_module_coke(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "coke";
 	mi->desc = "Atari Falcon COKE image (.TG1)";
 	mi->run_fn = de_run_coke;
-	mi->identify_fn = de_identify_coke;
+	mi->sigs = coke_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(coke_sigs);
 }
@@ -107,17 +107,15 @@ done:
 	de_free(c, si);
 }
 
-static int de_identify_autocad_slb(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "AutoCAD Slide Library 1.0\r\n\x1a", 28))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig autocad_slb_sigs[] = {
+	{ 0, "AutoCAD Slide Library 1.0\r\n\x1a", 28, 100 }
+};
 
 void de_module_autocad_slb(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "autocad_slb";
 	mi->desc = "AutoCAD Slide Library";
 	mi->run_fn = de_run_autocad_slb;
-	mi->identify_fn = de_identify_autocad_slb;
+	mi->sigs = autocad_slb_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(autocad_slb_sigs);
 }
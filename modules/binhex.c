@@ -238,8 +238,12 @@ static void do_extract_forks(deark *c, lctx *d)
 
 	de_advfile_run(d->advf);
 
-	do_post_extract_fork(c, d, &d->fki_data);
-	do_post_extract_fork(c, d, &d->fki_rsrc);
+	if(!d->advf->mainfork.write_skipped) {
+		do_post_extract_fork(c, d, &d->fki_data);
+	}
+	if(!d->advf->rsrcfork.write_skipped) {
+		do_post_extract_fork(c, d, &d->fki_rsrc);
+	}
 
 done:
 	de_destroy_stringreaderdata(c, fname);
@@ -1774,12 +1774,9 @@ static void de_run_bmff(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_jpeg2000(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x00\x00\x0c\x6a\x50\x20\x20\x0d\x0a\x87\x0a", 12))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig jpeg2000_sigs[] = {
+	{ 0, "\x00\x00\x00\x0c\x6a\x50\x20\x20\x0d\x0a\x87\x0a", 12, 100 }
+};
 
 static void de_help_bmff(deark *c)
 {
@@ -1792,7 +1789,8 @@ void de_module_jpeg2000(deark *c, struct deark_module_info *mi)
 	mi->desc = "JPEG 2000 image";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_bmff;
-	mi->identify_fn = de_identify_jpeg2000;
+	mi->sigs = jpeg2000_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(jpeg2000_sigs);
 }
 
 static int de_identify_bmff(deark *c)
@@ -528,16 +528,9 @@ static void do_image_paletted(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 static void do_image_24bit(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 {
 	de_bitmap *img = NULL;
-	i64 i, j;
-	u32 clr;
 
 	img = bmp_bitmap_create(c, d, 3);
-	for(j=0; j<d->height; j++) {
-		for(i=0; i<d->width; i++) {
-			clr = dbuf_getRGB(bits, bits_offset + j*d->rowspan + 3*i, DE_GETRGBFLAG_BGR);
-			de_bitmap_setpixel_rgb(img, i, j, clr);
-		}
-	}
+	de_convert_image_rgb(bits, bits_offset, d->rowspan, 3, img, DE_GETRGBFLAG_BGR);
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
 }
@@ -550,6 +543,9 @@ static void do_image_16_32bit(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 	u32 v;
 	i64 k;
 	u8 sm[4];
+	i64 bytes_per_pixel;
+	u8 *rowbuf = NULL;
+	u32 *clrbuf = NULL;
 
 	if(d->bitfields_type==BF_SEGMENT) {
 		has_transparency = (d->bitfields_segment_len>=16 && d->bitfield[3].mask!=0);
@@ -562,13 +558,19 @@ static void do_image_16_32bit(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 	}
 
 	img = bmp_bitmap_create(c, d, has_transparency?4:3);
+	if(!de_good_image_dimensions_noerr(c, d->width, d->height)) goto done;
+	bytes_per_pixel = (d->bitcount==16) ? 2 : 4;
+	rowbuf = de_malloc(c, d->width * bytes_per_pixel);
+	clrbuf = de_mallocarray(c, d->width, sizeof(u32));
+
 	for(j=0; j<d->height; j++) {
+		dbuf_read(bits, rowbuf, bits_offset + j*d->rowspan, d->width * bytes_per_pixel);
 		for(i=0; i<d->width; i++) {
 			if(d->bitcount==16) {
-				v = (u32)dbuf_getu16le(bits, bits_offset + j*d->rowspan + 2*i);
+				v = (u32)de_getu16le_direct(&rowbuf[2*i]);
 			}
 			else {
-				v = (u32)dbuf_getu32le(bits, bits_offset + j*d->rowspan + 4*i);
+				v = (u32)de_getu32le_direct(&rowbuf[4*i]);
 			}
 
 			for(k=0; k<4; k++) {
@@ -582,11 +584,16 @@ static void do_image_16_32bit(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 						sm[k] = 0; // Default other samples = 0
 				}
 			}
-			de_bitmap_setpixel_rgba(img, i, j, DE_MAKE_RGBA(sm[0], sm[1], sm[2], sm[3]));
+			clrbuf[i] = DE_MAKE_RGBA(sm[0], sm[1], sm[2], sm[3]);
 		}
+		de_bitmap_setpixels_rgba(img, 0, j, d->width, clrbuf);
 	}
+
+done:
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
+	de_free(c, rowbuf);
+	de_free(c, clrbuf);
 }
 
 static void do_image_rle_4_8_24(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
@@ -710,7 +717,7 @@ static void do_image_rle_4_8_24(deark *c, lctx *d, dbuf *bits, i64 bits_offset)
 		}
 	}
 
-	de_bitmap_write_to_file_finfo(img, d->fi, DE_CREATEFLAG_OPT_IMAGE);
+	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
 }
 
@@ -160,13 +160,9 @@ static void de_run_bpg(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_bpg(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x42\x50\x47\xfb", 4)) {
-		return 100;
-	}
-	return 0;
-}
+static const struct deark_module_sig bpg_sigs[] = {
+	{ 0, "BPG\xfb", 4, 100 }
+};
 
 void de_module_bpg(deark *c, struct deark_module_info *mi)
 {
@@ -174,5 +170,6 @@ void de_module_bpg(deark *c, struct deark_module_info *mi)
 	mi->desc = "BPG (Better Portable Graphics)";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_bpg;
-	mi->identify_fn = de_identify_bpg;
+	mi->sigs = bpg_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(bpg_sigs);
 }
@@ -0,0 +1,446 @@
+// This file is part of Deark.
+// Copyright (C) 2026 Jason Summers
+// See the file COPYING for terms of use.
+
+// Extract embedded files of various formats from arbitrary files.
+
+#include <deark-config.h>
+#include <deark-private.h>
+#include <deark-fmtutil.h>
+DE_DECLARE_MODULE(de_module_carve);
+
+struct carvectx_struct;
+
+// Returns the length of the embedded file starting at pos, or 0 if it
+// doesn't look valid. May change *pext.
+typedef i64 (*carve_detect_fn)(deark *c, struct carvectx_struct *d, i64 pos,
+	const char **pext);
+
+struct carve_sig {
+	const char *name;
+	const char *ext; // default extension
+	u8 siglen;
+	const u8 sig[8];
+	carve_detect_fn detect_fn;
+};
+
+#define CARVE_MAX_SIGS 16
+#define CARVE_MAX_STATES 128
+
+typedef struct carvectx_struct {
+	i64 endpos;
+
+	// Aho-Corasick automaton, converted to a DFA.
+	// delta[s][b] is the state to go to from state s on input byte b.
+	// outputs[s] is the set (a bitmask of indices into carve_sigs[]) of
+	// signatures that end when state s is reached.
+	size_t num_states;
+	u8 delta[CARVE_MAX_STATES][256];
+	u32 outputs[CARVE_MAX_STATES];
+
+	u8 state;
+	i64 scan_startpos; // Start of the current dbuf_buffered_read() call
+	u8 found_flag;
+	i64 resume_pos; // Where to start scanning again, after extracting a file
+	i64 num_found[CARVE_MAX_SIGS];
+
+	// ZIP EOCD records, indexed by implied start of file. Created when needed.
+	struct de_inthashtable *zip_eocds;
+} lctx;
+
+static i64 detect_jpeg(deark *c, lctx *d, i64 pos, const char **pext)
+{
+	i64 len = 0;
+	u8 is_jpegls = 0;
+
+	if(!de_fmtutil_detect_jpeg_len(c, c->infile, pos, d->endpos-pos, &len, &is_jpegls)) {
+		return 0;
+	}
+	if(is_jpegls) *pext = "jls";
+	return len;
+}
+
+static int is_png_chunk_type_char(u8 b)
+{
+	return (b>='A' && b<='Z') || (b>='a' && b<='z');
+}
+
+static i64 detect_png(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	i64 pos = pos1+8;
+	u8 ct[4];
+
+	while(1) {
+		i64 clen;
+		size_t k;
+
+		if(pos+12 > d->endpos) return 0;
+		clen = de_getu32be(pos);
+		if(clen>0x7fffffff) return 0;
+		de_read(ct, pos+4, 4);
+		for(k=0; k<4; k++) {
+			if(!is_png_chunk_type_char(ct[k])) return 0;
+		}
+		pos += 12+clen;
+		if(pos > d->endpos) return 0;
+		if(!de_memcmp(ct, "IEND", 4)) break;
+	}
+	return pos-pos1;
+}
+
+// Skip over a sequence of GIF data sub-blocks, updating *ppos.
+static int skip_gif_subblocks(deark *c, lctx *d, i64 *ppos)
+{
+	while(1) {
+		i64 n;
+
+		if(*ppos >= d->endpos) return 0;
+		n = (i64)de_getbyte_p(ppos);
+		if(n==0) break;
+		*ppos += n;
+	}
+	return 1;
+}
+
+static i64 detect_gif(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	i64 pos;
+	u8 flags;
+
+	flags = de_getbyte(pos1+10);
+	pos = pos1+13;
+	if(flags&0x80) {
+		pos += 3*((i64)1<<((flags&0x07)+1)); // global color table
+	}
+
+	while(1) {
+		u8 blocktype;
+
+		if(pos >= d->endpos) return 0;
+		blocktype = de_getbyte_p(&pos);
+		if(blocktype==0x3b) { // Trailer
+			break;
+		}
+		else if(blocktype==0x21) { // Extension
+			pos++; // label
+			if(!skip_gif_subblocks(c, d, &pos)) return 0;
+		}
+		else if(blocktype==0x2c) { // Image
+			flags = de_getbyte(pos+8);
+			pos += 9;
+			if(flags&0x80) {
+				pos += 3*((i64)1<<((flags&0x07)+1)); // local color table
+			}
+			pos++; // LZW minimum code size
+			if(!skip_gif_subblocks(c, d, &pos)) return 0;
+		}
+		else {
+			return 0;
+		}
+	}
+	return pos-pos1;
+}
+
+struct zip_eocd_item {
+	i64 eocdpos;
+	i64 cmt_len;
+};
+
+// Find every ZIP end-of-central-directory record in the file, and index them
+// by the position at which the ZIP file would have to start (the position of
+// the central directory, minus its offset). If several EOCD records imply the
+// same start, the first one is kept.
+// This is done at most once, the first time a ZIP signature is found, so
+// that the cost doesn't depend on the number of candidate signatures.
+static void find_zip_eocds(deark *c, lctx *d)
+{
+	i64 pos = 0;
+
+	d->zip_eocds = de_inthashtable_create(c);
+
+	while(1) {
+		i64 eocdpos;
+		i64 cdir_size, cdir_offset;
+		struct zip_eocd_item *item;
+
+		if(!dbuf_search(c->infile, (const u8*)"PK\x05\x06", 4, pos, d->endpos-pos, &eocdpos)) {
+			break;
+		}
+		if(eocdpos+22 > d->endpos) break;
+		pos = eocdpos+1;
+
+		cdir_size = de_getu32le(eocdpos+12);
+		cdir_offset = de_getu32le(eocdpos+16);
+		// There has to be room for at least one local file header.
+		if(cdir_offset+cdir_size < 30) continue;
+		if(cdir_offset+cdir_size > eocdpos) continue;
+
+		item = de_malloc(c, sizeof(struct zip_eocd_item));
+		item->eocdpos = eocdpos;
+		item->cmt_len = de_getu16le(eocdpos+20);
+		if(!de_inthashtable_add_item(c, d->zip_eocds, eocdpos-(cdir_offset+cdir_size),
+			(void*)item))
+		{
+			de_free(c, item);
+		}
+	}
+}
+
+static void free_zip_eocds(deark *c, lctx *d)
+{
+	if(!d->zip_eocds) return;
+	while(1) {
+		i64 key;
+		void *removed_item;
+
+		if(!de_inthashtable_remove_any_item(c, d->zip_eocds, &key, &removed_item)) {
+			break;
+		}
+		de_free(c, removed_item);
+	}
+	de_inthashtable_destroy(c, d->zip_eocds);
+	d->zip_eocds = NULL;
+}
+
+// Look for an end-of-central-directory record whose central directory
+// immediately precedes it, as if pos1 were the start of the file.
+static i64 detect_zip(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	void *item1 = NULL;
+	struct zip_eocd_item *item;
+
+	if(!d->zip_eocds) {
+		find_zip_eocds(c, d);
+	}
+	if(!de_inthashtable_get_item(c, d->zip_eocds, pos1, &item1)) {
+		return 0;
+	}
+	item = (struct zip_eocd_item*)item1;
+	return de_min_int(item->eocdpos+22+item->cmt_len, d->endpos) - pos1;
+}
+
+static i64 detect_bmp(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	i64 filesize, bits_offset, infohdrsize;
+
+	filesize = de_getu32le(pos1+2);
+	bits_offset = de_getu32le(pos1+10);
+	infohdrsize = de_getu32le(pos1+14);
+
+	if(infohdrsize!=12 && infohdrsize!=16 && infohdrsize!=40 && infohdrsize!=52 &&
+		infohdrsize!=56 && infohdrsize!=64 && infohdrsize!=108 && infohdrsize!=124)
+	{
+		return 0;
+	}
+	if(bits_offset < 14+infohdrsize || bits_offset >= filesize) return 0;
+	if(pos1+filesize > d->endpos) return 0;
+	return filesize;
+}
+
+static i64 detect_riff(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	i64 size;
+	u8 formtype[4];
+	size_t k;
+
+	size = de_getu32le(pos1+4);
+	if(size<4 || pos1+8+size > d->endpos) return 0;
+	de_read(formtype, pos1+8, 4);
+	for(k=0; k<4; k++) {
+		if(formtype[k]<32 || formtype[k]>126) return 0;
+	}
+
+	if(!de_memcmp(formtype, "WAVE", 4)) *pext = "wav";
+	else if(!de_memcmp(formtype, "AVI ", 4)) *pext = "avi";
+	else if(!de_memcmp(formtype, "WEBP", 4)) *pext = "webp";
+	return 8+size;
+}
+
+// Looks for the first %%EOF marker. This will truncate PDF files that have
+// been incrementally updated.
+static i64 detect_pdf(deark *c, lctx *d, i64 pos1, const char **pext)
+{
+	i64 pos;
+	u8 b;
+
+	b = de_getbyte(pos1+5);
+	if(b<'0' || b>'9') return 0;
+
+	if(!dbuf_search(c->infile, (const u8*)"%%EOF", 5, pos1+5, d->endpos-pos1-5, &pos)) {
+		return 0;
+	}
+	pos += 5;
+	if(pos<d->endpos && de_getbyte(pos)==0x0d) pos++;
+	if(pos<d->endpos && de_getbyte(pos)==0x0a) pos++;
+	return pos-pos1;
+}
+
+static const struct carve_sig carve_sigs[] = {
+	{ "JPEG", "jpg", 3, {0xff,0xd8,0xff}, detect_jpeg },
+	{ "PNG", "png", 8, {0x89,'P','N','G',0x0d,0x0a,0x1a,0x0a}, detect_png },
+	{ "GIF87a", "gif", 6, {'G','I','F','8','7','a'}, detect_gif },
+	{ "GIF89a", "gif", 6, {'G','I','F','8','9','a'}, detect_gif },
+	{ "ZIP", "zip", 4, {'P','K',0x03,0x04}, detect_zip },
+	{ "BMP", "bmp", 2, {'B','M'}, detect_bmp },
+	{ "RIFF", "riff", 4, {'R','I','F','F'}, detect_riff },
+	{ "PDF", "pdf", 5, {'%','P','D','F','-'}, detect_pdf }
+};
+
+static void build_automaton(deark *c, lctx *d)
+{
+	size_t num_sigs = DE_ARRAYCOUNT(carve_sigs);
+	size_t i, k;
+	u8 fail[CARVE_MAX_STATES];
+	u8 queue[CARVE_MAX_STATES];
+	size_t q_head, q_tail;
+	unsigned int b;
+
+	// State 0 is the root. A delta entry of 0 means "no trie edge", until
+	// the failure transitions are filled in.
+	d->num_states = 1;
+
+	for(i=0; i<num_sigs; i++) {
+		u8 s = 0;
+
+		for(k=0; k<(size_t)carve_sigs[i].siglen; k++) {
+			u8 b1 = carve_sigs[i].sig[k];
+
+			if(d->delta[s][b1]==0) {
+				d->delta[s][b1] = (u8)d->num_states;
+				d->num_states++;
+			}
+			s = d->delta[s][b1];
+		}
+		d->outputs[s] |= (u32)1<<i;
+	}
+
+	// Breadth-first traversal, to compute failure links, and complete the DFA.
+	q_head = 0;
+	q_tail = 0;
+	fail[0] = 0;
+	for(b=0; b<256; b++) {
+		u8 s = d->delta[0][b];
+
+		if(s!=0) {
+			fail[s] = 0;
+			queue[q_tail++] = s;
+		}
+	}
+
+	while(q_head<q_tail) {
+		u8 r = queue[q_head++];
+
+		d->outputs[r] |= d->outputs[fail[r]];
+		for(b=0; b<256; b++) {
+			u8 s = d->delta[r][b];
+
+			if(s!=0) {
+				fail[s] = d->delta[fail[r]][b];
+				queue[q_tail++] = s;
+			}
+			else {
+				d->delta[r][b] = d->delta[fail[r]][b];
+			}
+		}
+	}
+
+	de_dbg2(c, "signatures: %d, automaton states: %d", (int)num_sigs,
+		(int)d->num_states);
+}
+
+// Called when one or more signatures end at file position 'endpos'.
+// Returns 1 if a file was extracted.
+static int handle_match(deark *c, lctx *d, u32 sigmask, i64 matchendpos)
+{
+	size_t i;
+
+	for(i=0; i<DE_ARRAYCOUNT(carve_sigs); i++) {
+		const struct carve_sig *cs = &carve_sigs[i];
+		const char *ext;
+		i64 pos1;
+		i64 len;
+
+		if(!(sigmask & ((u32)1<<i))) continue;
+		pos1 = matchendpos+1-(i64)cs->siglen;
+		ext = cs->ext;
+		len = cs->detect_fn(c, d, pos1, &ext);
+		if(len<1) continue;
+
+		de_dbg(c, "%s at %"I64_FMT", length=%"I64_FMT, cs->name, pos1, len);
+		dbuf_create_file_from_slice(c->infile, pos1, len, ext, NULL, 0);
+		d->num_found[i]++;
+		d->resume_pos = pos1+len;
+		return 1;
+	}
+	return 0;
+}
+
+static int scan_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
+	i64 buf_len)
+{
+	lctx *d = (lctx*)brctx->userdata;
+	i64 basepos = d->scan_startpos + brctx->offset;
+	u8 s = d->state;
+	i64 i;
+
+	for(i=0; i<buf_len; i++) {
+		s = d->delta[s][buf[i]];
+		if(d->outputs[s]) {
+			if(handle_match(brctx->c, d, d->outputs[s], basepos+i)) {
+				// Start over from the end of the extracted file.
+				d->found_flag = 1;
+				return 0;
+			}
+		}
+	}
+
+	d->state = s;
+	return 1;
+}
+
+static void de_run_carve(deark *c, de_module_params *mparams)
+{
+	lctx *d = NULL;
+	i64 pos;
+	i64 start_time;
+	double elapsed;
+	size_t i;
+
+	d = de_malloc(c, sizeof(lctx));
+	d->endpos = c->infile->len;
+	build_automaton(c, d);
+
+	start_time = de_get_highres_time_ns();
+
+	pos = 0;
+	while(pos < d->endpos) {
+		d->scan_startpos = pos;
+		d->state = 0;
+		d->found_flag = 0;
+		dbuf_buffered_read(c->infile, pos, d->endpos-pos, scan_cbfn, (void*)d);
+		if(!d->found_flag) break; // Reached the end
+		pos = d->resume_pos;
+	}
+
+	elapsed = (double)(de_get_highres_time_ns() - start_time) / 1000000000.0;
+
+	for(i=0; i<DE_ARRAYCOUNT(carve_sigs); i++) {
+		if(d->num_found[i]) {
+			de_dbg(c, "%s files found: %"I64_FMT, carve_sigs[i].name, d->num_found[i]);
+		}
+	}
+	if(elapsed>0.0) {
+		de_dbg(c, "scanned %"I64_FMT" bytes in %.3f seconds (%.1f MB/s)",
+			c->infile->len, elapsed, (double)c->infile->len/elapsed/1000000.0);
+	}
+
+	free_zip_eocds(c, d);
+	de_free(c, d);
+}
+
+void de_module_carve(deark *c, struct deark_module_info *mi)
+{
+	mi->id = "carve";
+	mi->desc = "Extract embedded files of various formats from arbitrary files";
+	mi->run_fn = de_run_carve;
+}
@@ -1882,12 +1882,9 @@ static void de_run_cfb(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_cfb(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig cfb_sigs[] = {
+	{ 0, "\xd0\xcf\x11\xe0\xa1\xb1\x1a\xe1", 8, 100 }
+};
 
 static void de_help_cfb(deark *c)
 {
@@ -1903,6 +1900,7 @@ void de_module_cfb(deark *c, struct deark_module_info *mi)
 	mi->id = "cfb";
 	mi->desc = "Microsoft Compound File Binary File";
 	mi->run_fn = de_run_cfb;
-	mi->identify_fn = de_identify_cfb;
+	mi->sigs = cfb_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(cfb_sigs);
 	mi->help_fn = de_help_cfb;
 }
@@ -395,7 +395,14 @@ static int read_member(deark *c, lctx *d, i64 pos1,
 	de_finfo_set_name_from_ucstring(c, md->fi, md->filename_srd->str, snflags);
 	md->fi->original_filename_flag = 1;
 
+	if(cpio_filetype==CPIOFT_REGULAR) {
+		md->fi->len_known = 1;
+		md->fi->len = md->filesize;
+	}
 	outf = dbuf_create_output_file(c, NULL, md->fi, 0);
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	if(md->subfmt==SUBFMT_ASCII_NEWCRC) {
 		// Use a callback function to calculate the checksum.
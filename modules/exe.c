@@ -1343,19 +1343,15 @@ static void de_run_exe(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_exe(deark *c)
-{
-	u8 buf[2];
-	de_read(buf, 0, 2);
-
-	if(buf[0]=='M' && buf[1]=='Z') return 80;
-	return 0;
-}
+static const struct deark_module_sig exe_sigs[] = {
+	{ 0, "MZ", 2, 80 }
+};
 
 void de_module_exe(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "exe";
 	mi->desc = "Microsoft EXE executable (PE, NE, LX)";
 	mi->run_fn = de_run_exe;
-	mi->identify_fn = de_identify_exe;
+	mi->sigs = exe_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(exe_sigs);
 }
@@ -198,18 +198,16 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_flif(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "FLIF", 4))
-		return 90;
-	return 0;
-}
+static const struct deark_module_sig flif_sigs[] = {
+	{ 0, "FLIF", 4, 90 }
+};
 
 void de_module_flif(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "flif";
 	mi->desc = "FLIF image format";
 	mi->run_fn = de_run_flif;
-	mi->identify_fn = de_identify_flif;
+	mi->sigs = flif_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(flif_sigs);
 	mi->flags |= DE_MODFLAG_NONWORKING;
 }
@@ -484,7 +484,7 @@ static void do_plaintext_extension(deark *c, lctx *d, i64 pos)
 	}
 
 	if(d->compose) {
-		de_bitmap_write_to_file_finfo(d->screen_img, d->fi, DE_CREATEFLAG_OPT_IMAGE);
+		de_bitmap_write_to_file_finfo(d->screen_img, d->fi, 0);
 
 		// TODO: Too much code is duplicated with do_image().
 		if(disposal_method==DISPOSE_BKGD) {
@@ -948,7 +948,7 @@ static int do_image(deark *c, lctx *d, i64 pos1, i64 *bytesused)
 			0, 0, d->screen_img->width, d->screen_img->height,
 			gi->xpos, gi->ypos, DE_BITMAPFLAG_MERGE);
 
-		de_bitmap_write_to_file_finfo(d->screen_img, d->fi, DE_CREATEFLAG_OPT_IMAGE);
+		de_bitmap_write_to_file_finfo(d->screen_img, d->fi, 0);
 
 		if(disposal_method == DISPOSE_BKGD) {
 			de_bitmap_rect(d->screen_img, gi->xpos, gi->ypos, gi->width, gi->height,
@@ -1069,7 +1069,7 @@ done:
 		if(d->screen_img) {
 			if(d->dump_screen) {
 				de_finfo_set_name_from_sz(c, d->fi, "screen", 0, DE_ENCODING_LATIN1);
-				de_bitmap_write_to_file_finfo(d->screen_img, d->fi, DE_CREATEFLAG_OPT_IMAGE);
+				de_bitmap_write_to_file_finfo(d->screen_img, d->fi, 0);
 				de_finfo_set_name_from_sz(c, d->fi, NULL, 0, DE_ENCODING_LATIN1);
 			}
 			de_bitmap_destroy(d->screen_img);
@@ -1080,15 +1080,10 @@ done:
 	}
 }
 
-static int de_identify_gif(deark *c)
-{
-	u8 buf[6];
-
-	de_read(buf, 0, 6);
-	if(!de_memcmp(buf, "GIF87a", 6)) return 100;
-	if(!de_memcmp(buf, "GIF89a", 6)) return 100;
-	return 0;
-}
+static const struct deark_module_sig gif_sigs[] = {
+	{ 0, "GIF87a", 6, 100 },
+	{ 0, "GIF89a", 6, 100 }
+};
 
 static void de_help_gif(deark *c)
 {
@@ -1102,6 +1097,7 @@ void de_module_gif(deark *c, struct deark_module_info *mi)
 	mi->id = "gif";
 	mi->desc = "GIF image";
 	mi->run_fn = de_run_gif;
-	mi->identify_fn = de_identify_gif;
+	mi->sigs = gif_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(gif_sigs);
 	mi->help_fn = de_help_gif;
 }
@@ -514,10 +514,16 @@ static int de_identify_icns(deark *c)
 	return 20;
 }
 
+static const struct deark_module_sig icns_sigs[] = {
+	{ 0, "icns", 4, 0 }
+};
+
 void de_module_icns(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "icns";
 	mi->desc = "Macintosh icon";
 	mi->run_fn = de_run_icns;
 	mi->identify_fn = de_identify_icns;
+	mi->sigs = icns_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(icns_sigs);
 }
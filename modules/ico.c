@@ -436,7 +436,7 @@ static int decode_win1_icon(deark *c, win1ctx *d, i64 pos1)
 		fi->hotspot_y = hotspot_y;
 	}
 
-	de_bitmap_write_to_file_finfo(img, fi, DE_CREATEFLAG_OPT_IMAGE);
+	de_bitmap_write_to_file_finfo(img, fi, 0);
 	d->bytes_consumed = pos - pos1;
 	retval = 1;
 
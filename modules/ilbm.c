@@ -1904,8 +1904,10 @@ static void do_ansq(deark *c, lctx *d, i64 pos1, i64 len)
 	de_dbg_indent(c, -1);
 }
 
-static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u32 *rowbuf,
-	UI rowbuf_size, de_bitmap *img)
+// The render_pixel_row_* functions convert a row of pixel values to colors,
+// in clrbuf.
+static void render_pixel_row_ham6(deark *c, lctx *d, const u32 *rowbuf,
+	UI rowbuf_size, u32 *clrbuf)
 {
 	UI i;
 	u8 cr, cg, cb;
@@ -1938,12 +1940,12 @@ static void render_pixel_row_ham6(deark *c, lctx *d, i64 rownum, const u32 *rowb
 			break;
 		}
 
-		de_bitmap_setpixel_rgb(img, (i64)i, rownum, DE_MAKE_RGB(cr, cg, cb));
+		clrbuf[i] = DE_MAKE_RGB(cr, cg, cb);
 	}
 }
 
-static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u32 *rowbuf,
-	UI rowbuf_size, de_bitmap *img)
+static void render_pixel_row_ham8(deark *c, lctx *d, const u32 *rowbuf,
+	UI rowbuf_size, u32 *clrbuf)
 {
 	UI i;
 	u8 cr, cg, cb;
@@ -1976,22 +1978,22 @@ static void render_pixel_row_ham8(deark *c, lctx *d, i64 rownum, const u32 *rowb
 			break;
 		}
 
-		de_bitmap_setpixel_rgb(img, (i64)i, rownum, DE_MAKE_RGB(cr, cg, cb));
+		clrbuf[i] = DE_MAKE_RGB(cr, cg, cb);
 	}
 }
 
 static void render_pixel_row_normal(deark *c, lctx *d, struct imgbody_info *ibi,
-	i64 rownum, const u32 *rowbuf, UI rowbuf_size, de_bitmap *img)
+	const u32 *rowbuf, UI rowbuf_size, u32 *clrbuf)
 {
 	UI k;
 
 	for(k=0; k<rowbuf_size; k++) {
-		de_bitmap_setpixel_rgb(img, (i64)k, rownum, d->pal[(UI)rowbuf[k] & 0xff]);
+		clrbuf[k] = d->pal[(UI)rowbuf[k] & 0xff];
 	}
 }
 
 static void render_pixel_row_rgb24(deark *c, lctx *d, struct imgbody_info *ibi,
-	i64 rownum, const u32 *rowbuf, UI rowbuf_size, de_bitmap *img)
+	const u32 *rowbuf, UI rowbuf_size, u32 *clrbuf)
 {
 	UI k;
 
@@ -2001,7 +2003,7 @@ static void render_pixel_row_rgb24(deark *c, lctx *d, struct imgbody_info *ibi,
 		r = (rowbuf[k] & 0x0000ff);
 		g = (rowbuf[k] & 0x00ff00)>>8;
 		b = (rowbuf[k] & 0xff0000)>>16;
-		de_bitmap_setpixel_rgb(img, (i64)k, rownum, DE_MAKE_RGB(r, g, b));
+		clrbuf[k] = DE_MAKE_RGB(r, g, b);
 	}
 }
 
@@ -2046,12 +2048,13 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 	i64 j;
 	u32 *rowbuf = NULL; // The current row of pixel (palette or RGB) values
 	u8 *rowbuf_trns = NULL; // The current row's 1-bit transparency mask values
+	u32 *clrbuf = NULL; // The current row of final colors
+	u8 *rawbuf = NULL; // The current row, as it is stored in the frame buffer
+	u8 *planebuf = NULL; // One plane of the current row, one byte per pixel
 	UI rowbuf_size;
 	int bypp;
 	de_finfo *fi = NULL;
 	UI createflags = 0;
-	u32 pixelval[8];
-	u8 pixeltrnsval[8];
 
 	if(d->errflag) goto done;
 	if(!frctx) goto done;
@@ -2080,6 +2083,7 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 	rowbuf_size = (UI)ibi->width;
 	rowbuf = de_mallocarray(c, rowbuf_size, sizeof(rowbuf[0]));
 	rowbuf_trns = de_mallocarray(c, rowbuf_size, sizeof(rowbuf_trns[0]));
+	clrbuf = de_mallocarray(c, rowbuf_size, sizeof(clrbuf[0]));
 
 	if(d->found_cmap && d->pal_is_grayscale && d->planes_raw<=8 && !d->is_ham6 && !d->is_ham8) {
 		bypp = 1;
@@ -2102,76 +2106,60 @@ static void write_frame(deark *c, lctx *d, struct imgbody_info *ibi, struct fram
 		goto after_render;
 	}
 
+	rawbuf = de_malloc(c, ibi->bytes_per_row_per_plane * ibi->planes_total);
+	planebuf = de_malloc(c, ibi->bytes_per_row_per_plane * 8);
+
 	for(j=0; j<ibi->height; j++) {
-		i64 z;
 		i64 plane;
 		UI k;
 
-		// Process 8 pixels at a time
-		for(z=0; z<ibi->bytes_per_row_per_plane; z++) {
-			de_zeromem(pixelval, sizeof(pixelval));
-			de_zeromem(pixeltrnsval, sizeof(pixeltrnsval));
+		de_zeromem(rowbuf, rowbuf_size * sizeof(rowbuf[0]));
+		de_zeromem(rowbuf_trns, rowbuf_size * sizeof(rowbuf_trns[0]));
 
-			// Read the zth byte in each plane
-			for(plane=0; plane<ibi->planes_total; plane++) {
-				u8 b;
+		dbuf_read(frctx->frame_buffer, rawbuf, j*ibi->frame_buffer_rowspan,
+			ibi->bytes_per_row_per_plane * ibi->planes_total);
 
-				b = dbuf_getbyte(frctx->frame_buffer,
-					j*ibi->frame_buffer_rowspan +
-					plane*ibi->bytes_per_row_per_plane + z);
+		for(plane=0; plane<ibi->planes_total; plane++) {
+			de_unpack_pixels(&rawbuf[plane*ibi->bytes_per_row_per_plane], 1,
+				(i64)rowbuf_size, planebuf, 0);
 
-				for(k=0; k<8; k++) {
-					if(b & (1U<<(7-k))) {
-						if(plane < ibi->planes_fg) {
-							pixelval[k] |= 1U<<(UI)plane;
-						}
-						else {
-							// The only way this can happen is if this plane is a
-							// 1-bit transparency mask.
-							pixeltrnsval[k] = 1;
-						}
-					}
+			if(plane < ibi->planes_fg) {
+				for(k=0; k<rowbuf_size; k++) {
+					rowbuf[k] |= (u32)planebuf[k]<<(UI)plane;
 				}
 			}
-
-			for(k=0; k<8; k++) {
-				UI idx;
-
-				idx = (UI)z*8+k;
-				if(idx < rowbuf_size) {
-					rowbuf[idx] = pixelval[k];
-					rowbuf_trns[idx] = pixeltrnsval[k];
+			else {
+				// The only way this can happen is if this plane is a
+				// 1-bit transparency mask.
+				for(k=0; k<rowbuf_size; k++) {
+					rowbuf_trns[k] |= planebuf[k];
 				}
 			}
 		}
 
 		if(ibi->colortype==COLORTYPE_RGB24) {
-			render_pixel_row_rgb24(c, d, ibi, j, rowbuf, rowbuf_size, img);
+			render_pixel_row_rgb24(c, d, ibi, rowbuf, rowbuf_size, clrbuf);
 		}
 		else if(d->is_ham6) {
-			render_pixel_row_ham6(c, d, j, rowbuf, rowbuf_size, img);
+			render_pixel_row_ham6(c, d, rowbuf, rowbuf_size, clrbuf);
 		}
 		else if(d->is_ham8) {
-			render_pixel_row_ham8(c, d, j, rowbuf, rowbuf_size, img);
+			render_pixel_row_ham8(c, d, rowbuf, rowbuf_size, clrbuf);
 		}
 		else {
-			render_pixel_row_normal(c, d, ibi, j, rowbuf, rowbuf_size, img);
+			render_pixel_row_normal(c, d, ibi, rowbuf, rowbuf_size, clrbuf);
 		}
 
 		// Handle 1-bit transparency masks here, for all color types.
 		if(ibi->masking_code==MASKINGTYPE_1BITMASK && !d->opt_notrans) {
-			i64 i;
-
-			for(i=0; i<rowbuf_size; i++) {
-				u32 clr;
-
-				if(rowbuf_trns[i]==0) {
-					clr = de_bitmap_getpixel(img, i, j);
-					clr = DE_SET_ALPHA(clr, 0);
-					de_bitmap_setpixel_rgba(img, i, j, clr);
+			for(k=0; k<rowbuf_size; k++) {
+				if(rowbuf_trns[k]==0) {
+					clrbuf[k] = DE_SET_ALPHA(clrbuf[k], 0);
 				}
 			}
 		}
+
+		de_bitmap_setpixels_rgba(img, 0, j, (i64)rowbuf_size, clrbuf);
 	}
 
 after_render:
@@ -2180,9 +2168,6 @@ after_render:
 	if(ibi->is_thumb) {
 		createflags |= DE_CREATEFLAG_IS_AUX;
 	}
-	if(!d->is_anim) {
-		createflags |= DE_CREATEFLAG_OPT_IMAGE;
-	}
 
 	de_bitmap_write_to_file_finfo(img, fi, createflags);
 
@@ -2191,6 +2176,9 @@ done:
 	de_finfo_destroy(c, fi);
 	de_free(c, rowbuf);
 	de_free(c, rowbuf_trns);
+	de_free(c, clrbuf);
+	de_free(c, rawbuf);
+	de_free(c, planebuf);
 }
 
 static void on_frame_begin(deark *c, lctx *d, u32 formtype)
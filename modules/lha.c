@@ -674,11 +674,18 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md,
 	else if(md->is_nonexecutable) {
 		fi->mode_flags |= DE_MODEFLAG_NONEXE;
 	}
+	if(!md->is_dir) {
+		fi->len_known = 1;
+		fi->len = md->orig_size;
+	}
 
 	de_finfo_set_name_from_ucstring(c, fi, md->fullfilename, DE_SNFLAG_FULLPATH);
 	fi->original_filename_flag = 1;
 
 	outf = dbuf_create_output_file(c, NULL, fi, 0x0);
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	if(!d->crco) {
 		d->crco = de_crcobj_create(c, DE_CRCOBJ_CRC16_ARC);
@@ -127,12 +127,18 @@ static int de_identify_megapaint_pat(deark *c)
 	return 40;
 }
 
+static const struct deark_module_sig megapaint_pat_sigs[] = {
+	{ 0, "\x07" "PAT", 4, 0 }
+};
+
 void de_module_megapaint_pat(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "megapaint_pat";
 	mi->desc = "MegaPaint Patterns";
 	mi->run_fn = de_run_megapaint_pat;
 	mi->identify_fn = de_identify_megapaint_pat;
+	mi->sigs = megapaint_pat_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(megapaint_pat_sigs);
 }
 
 // **************************************************************************
@@ -176,10 +182,16 @@ static int de_identify_megapaint_lib(deark *c)
 	return 40;
 }
 
+static const struct deark_module_sig megapaint_lib_sigs[] = {
+	{ 0, "\x07" "LIB", 4, 0 }
+};
+
 void de_module_megapaint_lib(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "megapaint_lib";
 	mi->desc = "MegaPaint Symbol Library";
 	mi->run_fn = de_run_megapaint_lib;
 	mi->identify_fn = de_identify_megapaint_lib;
+	mi->sigs = megapaint_lib_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(megapaint_lib_sigs);
 }
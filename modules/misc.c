@@ -12,6 +12,7 @@ DE_DECLARE_MODULE(de_module_copy);
 DE_DECLARE_MODULE(de_module_null);
 DE_DECLARE_MODULE(de_module_cp437);
 DE_DECLARE_MODULE(de_module_crc);
+DE_DECLARE_MODULE(de_module_crctest);
 DE_DECLARE_MODULE(de_module_hexdump);
 DE_DECLARE_MODULE(de_module_bytefreq);
 DE_DECLARE_MODULE(de_module_zlib);
@@ -195,6 +196,32 @@ void de_module_crc(deark *c, struct deark_module_info *mi)
 	mi->flags |= DE_MODFLAG_NOEXTRACT;
 }
 
+// **************************************************************************
+// crctest
+// Tests and benchmarks Deark's CRC functions. The input file is ignored.
+// **************************************************************************
+
+static void de_run_crctest(deark *c, de_module_params *mparams)
+{
+	int nfailures;
+
+	nfailures = de_crc_selftest(c);
+	if(nfailures) {
+		de_err(c, "CRC self-test failed (%d errors)", nfailures);
+	}
+	else {
+		de_msg(c, "CRC self-test passed");
+	}
+}
+
+void de_module_crctest(deark *c, struct deark_module_info *mi)
+{
+	mi->id = "crctest";
+	mi->desc = "Test the CRC functions";
+	mi->run_fn = de_run_crctest;
+	mi->flags |= DE_MODFLAG_HIDDEN | DE_MODFLAG_NOEXTRACT;
+}
+
 // **************************************************************************
 // hexdump
 // Prints a hex dump. Does not create any files.
@@ -546,12 +573,9 @@ static void de_run_mrw(deark *c, de_module_params *mparams)
 	do_mrw_seg_list(c, 8, mrw_seg_size);
 }
 
-static int de_identify_mrw(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x4d\x52\x4d", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig mrw_sigs[] = {
+	{ 0, "\x00\x4d\x52\x4d", 4, 100 }
+};
 
 void de_module_mrw(deark *c, struct deark_module_info *mi)
 {
@@ -559,7 +583,8 @@ void de_module_mrw(deark *c, struct deark_module_info *mi)
 	mi->desc = "Minolta RAW";
 	mi->desc2 = "resources only";
 	mi->run_fn = de_run_mrw;
-	mi->identify_fn = de_identify_mrw;
+	mi->sigs = mrw_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(mrw_sigs);
 }
 
 // **************************************************************************
@@ -993,19 +1018,17 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_lss16(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x3d\xf3\x13\x14", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig lss16_sigs[] = {
+	{ 0, "\x3d\xf3\x13\x14", 4, 100 }
+};
 
 void de_module_lss16(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "lss16";
 	mi->desc = "SYSLINUX LSS16 image";
 	mi->run_fn = de_run_lss16;
-	mi->identify_fn = de_identify_lss16;
+	mi->sigs = lss16_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(lss16_sigs);
 }
 
 // **************************************************************************
@@ -1179,19 +1202,17 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_olpc565(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "C565", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig olpc565_sigs[] = {
+	{ 0, "C565", 4, 100 }
+};
 
 void de_module_olpc565(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "olpc565";
 	mi->desc = "OLPC .565 firmware icon";
 	mi->run_fn = de_run_olpc565;
-	mi->identify_fn = de_identify_olpc565;
+	mi->sigs = olpc565_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(olpc565_sigs);
 }
 
 // **************************************************************************
@@ -1234,19 +1255,17 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_iim(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "IS_IMAGE", 8))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig iim_sigs[] = {
+	{ 0, "IS_IMAGE", 8, 100 }
+};
 
 void de_module_iim(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "iim";
 	mi->desc = "InShape IIM";
 	mi->run_fn = de_run_iim;
-	mi->identify_fn = de_identify_iim;
+	mi->sigs = iim_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(iim_sigs);
 }
 
 // **************************************************************************
@@ -1329,21 +1348,18 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_pm_xv(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "VIEW", 4))
-		return 15;
-	if(!dbuf_memcmp(c->infile, 0, "WEIV", 4))
-		return 15;
-	return 0;
-}
+static const struct deark_module_sig pm_xv_sigs[] = {
+	{ 0, "VIEW", 4, 15 },
+	{ 0, "WEIV", 4, 15 }
+};
 
 void de_module_pm_xv(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pm_xv";
 	mi->desc = "PM (XV)";
 	mi->run_fn = de_run_pm_xv;
-	mi->identify_fn = de_identify_pm_xv;
+	mi->sigs = pm_xv_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pm_xv_sigs);
 }
 
 // **************************************************************************
@@ -1410,19 +1426,17 @@ done:
 	dbuf_close(unc_pixels);
 }
 
-static int de_identify_crg(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "CALAMUSCRG", 10))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig crg_sigs[] = {
+	{ 0, "CALAMUSCRG", 10, 100 }
+};
 
 void de_module_crg(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "crg";
 	mi->desc = "Calamus Raster Graphic";
 	mi->run_fn = de_run_crg;
-	mi->identify_fn = de_identify_crg;
+	mi->sigs = crg_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(crg_sigs);
 }
 
 // **************************************************************************
@@ -1458,19 +1472,17 @@ static void de_run_farbfeld(deark *c, de_module_params *mparams)
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_farbfeld(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "farbfeld", 8))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig farbfeld_sigs[] = {
+	{ 0, "farbfeld", 8, 100 }
+};
 
 void de_module_farbfeld(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "farbfeld";
 	mi->desc = "farbfeld image";
 	mi->run_fn = de_run_farbfeld;
-	mi->identify_fn = de_identify_farbfeld;
+	mi->sigs = farbfeld_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(farbfeld_sigs);
 }
 
 // **************************************************************************
@@ -1627,19 +1639,17 @@ done:
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_hsiraw(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "mhwanh", 6))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig hsiraw_sigs[] = {
+	{ 0, "mhwanh", 6, 100 }
+};
 
 void de_module_hsiraw(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "hsiraw";
 	mi->desc = "HSI Raw";
 	mi->run_fn = de_run_hsiraw;
-	mi->identify_fn = de_identify_hsiraw;
+	mi->sigs = hsiraw_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(hsiraw_sigs);
 }
 
 // **************************************************************************
@@ -1780,19 +1790,17 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_vitec(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x00\x5b\x07\x20", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig vitec_sigs[] = {
+	{ 0, "\x00\x5b\x07\x20", 4, 100 }
+};
 
 void de_module_vitec(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "vitec";
 	mi->desc = "VITec image format";
 	mi->run_fn = de_run_vitec;
-	mi->identify_fn = de_identify_vitec;
+	mi->sigs = vitec_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(vitec_sigs);
 }
 
 // **************************************************************************
@@ -1951,6 +1959,10 @@ static int de_identify_zbr(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig zbr_sigs[] = {
+	{ 0, "\x9a\x02", 2, 0 }
+};
+
 void de_module_zbr(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "zbr";
@@ -1958,6 +1970,8 @@ void de_module_zbr(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "extract preview image";
 	mi->run_fn = de_run_zbr;
 	mi->identify_fn = de_identify_zbr;
+	mi->sigs = zbr_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(zbr_sigs);
 }
 
 // **************************************************************************
@@ -2016,6 +2030,10 @@ static int de_identify_cdr_wl(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig cdr_wl_sigs[] = {
+	{ 0, "WL", 2, 0 }
+};
+
 void de_module_cdr_wl(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "cdr_wl";
@@ -2023,6 +2041,8 @@ void de_module_cdr_wl(deark *c, struct deark_module_info *mi)
 	mi->desc2 = "extract preview image";
 	mi->run_fn = de_run_cdr_wl;
 	mi->identify_fn = de_identify_cdr_wl;
+	mi->sigs = cdr_wl_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(cdr_wl_sigs);
 }
 
 // **************************************************************************
@@ -2057,19 +2077,17 @@ static void de_run_compress(deark *c, de_module_params *mparams)
 	dbuf_close(f);
 }
 
-static int de_identify_compress(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x1f\x9d", 2))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig compress_sigs[] = {
+	{ 0, "\x1f\x9d", 2, 100 }
+};
 
 void de_module_compress(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "compress";
 	mi->desc = "Compress (.Z)";
 	mi->run_fn = de_run_compress;
-	mi->identify_fn = de_identify_compress;
+	mi->sigs = compress_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(compress_sigs);
 }
 
 // **************************************************************************
@@ -2154,12 +2172,18 @@ static int de_identify_gws_thn(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig gws_thn_sigs[] = {
+	{ 0, "THNL", 4, 0 }
+};
+
 void de_module_gws_thn(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "gws_thn";
 	mi->desc = "Graphic Workshop thumbnail .THN";
 	mi->run_fn = de_run_gws_thn;
 	mi->identify_fn = de_identify_gws_thn;
+	mi->sigs = gws_thn_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(gws_thn_sigs);
 }
 
 // **************************************************************************
@@ -2217,18 +2241,17 @@ static void de_run_deskmate_pnt(deark *c, de_module_params *mparams)
 	de_bitmap_destroy(img);
 }
 
-static int de_identify_deskmate_pnt(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x13" "PNT", 4)) return 100;
-	return 0;
-}
+static const struct deark_module_sig deskmate_pnt_sigs[] = {
+	{ 0, "\x13" "PNT", 4, 100 }
+};
 
 void de_module_deskmate_pnt(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "deskmate_pnt";
 	mi->desc = "Tandy DeskMate Paint";
 	mi->run_fn = de_run_deskmate_pnt;
-	mi->identify_fn = de_identify_deskmate_pnt;
+	mi->sigs = deskmate_pnt_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(deskmate_pnt_sigs);
 }
 
 
@@ -2273,18 +2296,17 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_corel_bmf(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "@CorelBMF\x0a\x0d", 11)) return 100;
-	return 0;
-}
+static const struct deark_module_sig corel_bmf_sigs[] = {
+	{ 0, "@CorelBMF\x0a\x0d", 11, 100 }
+};
 
 void de_module_corel_bmf(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "corel_bmf";
 	mi->desc = "Corel Gallery BMF";
 	mi->run_fn = de_run_corel_bmf;
-	mi->identify_fn = de_identify_corel_bmf;
+	mi->sigs = corel_bmf_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(corel_bmf_sigs);
 }
 
 // **************************************************************************
@@ -2317,18 +2339,17 @@ static void de_run_hpi(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_hpi(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x89\x48\x50\x49\x0d\x0a\x1a\x0a", 8)) return 100;
-	return 0;
-}
+static const struct deark_module_sig hpi_sigs[] = {
+	{ 0, "\x89\x48\x50\x49\x0d\x0a\x1a\x0a", 8, 100 }
+};
 
 void de_module_hpi(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "hpi";
 	mi->desc = "Hemera Photo-Object image";
 	mi->run_fn = de_run_hpi;
-	mi->identify_fn = de_identify_hpi;
+	mi->sigs = hpi_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(hpi_sigs);
 }
 
 // **************************************************************************
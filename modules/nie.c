@@ -172,7 +172,7 @@ static void do_decode_nie(deark *c, lctx *d)
 		}
 	}
 
-	de_bitmap_write_to_file(img, NULL, DE_CREATEFLAG_OPT_IMAGE);
+	de_bitmap_write_to_file(img, NULL, 0);
 
 done:
 	de_bitmap_destroy(img);
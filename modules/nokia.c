@@ -59,18 +59,17 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_nol(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "NOL", 3)) return 80;
-	return 0;
-}
+static const struct deark_module_sig nol_sigs[] = {
+	{ 0, "NOL", 3, 80 }
+};
 
 void de_module_nol(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "nol";
 	mi->desc = "Nokia Operator Logo";
 	mi->run_fn = de_run_nol;
-	mi->identify_fn = de_identify_nol;
+	mi->sigs = nol_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(nol_sigs);
 }
 
 // **************************************************************************
@@ -94,18 +93,17 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_ngg(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "NGG", 3)) return 80;
-	return 0;
-}
+static const struct deark_module_sig ngg_sigs[] = {
+	{ 0, "NGG", 3, 80 }
+};
 
 void de_module_ngg(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ngg";
 	mi->desc = "Nokia Group Graphic";
 	mi->run_fn = de_run_ngg;
-	mi->identify_fn = de_identify_ngg;
+	mi->sigs = ngg_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(ngg_sigs);
 }
 
 // **************************************************************************
@@ -148,18 +146,17 @@ static void de_run_npm(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_npm(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "NPM", 3)) return 80;
-	return 0;
-}
+static const struct deark_module_sig npm_sigs[] = {
+	{ 0, "NPM", 3, 80 }
+};
 
 void de_module_npm(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "npm";
 	mi->desc = "Nokia Picture Message";
 	mi->run_fn = de_run_npm;
-	mi->identify_fn = de_identify_npm;
+	mi->sigs = npm_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(npm_sigs);
 }
 
 // **************************************************************************
@@ -195,18 +192,17 @@ static void de_run_nlm(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_nlm(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "NLM ", 4)) return 80;
-	return 0;
-}
+static const struct deark_module_sig nlm_sigs[] = {
+	{ 0, "NLM ", 4, 80 }
+};
 
 void de_module_nlm(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "nlm";
 	mi->desc = "Nokia Logo Manager bitmap";
 	mi->run_fn = de_run_nlm;
-	mi->identify_fn = de_identify_nlm;
+	mi->sigs = nlm_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(nlm_sigs);
 }
 
 // **************************************************************************
@@ -194,7 +194,7 @@ static void do_write_final_image(deark *c, struct os2icoctx *d, de_bitmap *img)
 		}
 	}
 
-	de_bitmap_write_to_file_finfo(img, fi, DE_CREATEFLAG_OPT_IMAGE);
+	de_bitmap_write_to_file_finfo(img, fi, 0);
 
 	de_finfo_destroy(c, fi);
 }
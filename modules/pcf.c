@@ -744,17 +744,15 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_pcf(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x01" "fcp", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig pcf_sigs[] = {
+	{ 0, "\x01" "fcp", 4, 100 }
+};
 
 void de_module_pcf(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pcf";
 	mi->desc = "PCF font";
 	mi->run_fn = de_run_pcf;
-	mi->identify_fn = de_identify_pcf;
+	mi->sigs = pcf_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pcf_sigs);
 }
@@ -481,26 +481,41 @@ static void do_bitmap_paletted(deark *c, lctx *d)
 	de_bitmap *img = NULL;
 	i64 i, j;
 	i64 plane;
-	u8 b;
-	unsigned int palent;
+	u8 *rawbuf = NULL;
+	u8 *planebuf = NULL;
+	u8 *idxbuf = NULL;
+	i64 plane_nbytes;
 
 	img = de_bitmap_create(c, d->width, d->height, 3);
+	if(!de_good_image_dimensions_noerr(c, d->width, d->height)) goto done;
+
+	plane_nbytes = (d->width*d->bits+7)/8;
+	rawbuf = de_malloc(c, plane_nbytes);
+	planebuf = de_malloc(c, d->width);
+	idxbuf = de_malloc(c, d->width);
 
 	for(j=0; j<d->height; j++) {
-		for(i=0; i<d->width; i++) {
-			palent = 0;
-			for(plane=0; plane<d->planes; plane++) {
-				b = de_get_bits_symbol(d->unc_pixels, d->bits,
-					j*d->rowspan + plane*d->rowspan_raw, i);
-				palent |= b<<(plane*d->bits);
+		for(plane=0; plane<d->planes; plane++) {
+			dbuf_read(d->unc_pixels, rawbuf, j*d->rowspan + plane*d->rowspan_raw,
+				plane_nbytes);
+			if(plane==0) {
+				de_unpack_pixels(rawbuf, d->bits, d->width, idxbuf, 0);
+				continue;
+			}
+			de_unpack_pixels(rawbuf, d->bits, d->width, planebuf, 0);
+			for(i=0; i<d->width; i++) {
+				idxbuf[i] |= (u8)(planebuf[i]<<(plane*d->bits));
 			}
-			if(palent>255) palent=0; // Should be impossible.
-			de_bitmap_setpixel_rgb(img, i, j, d->pal[palent]);
 		}
+		de_bitmap_setpixels_paletted(img, 0, j, d->width, idxbuf, d->pal);
 	}
 
+done:
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
+	de_free(c, rawbuf);
+	de_free(c, planebuf);
+	de_free(c, idxbuf);
 }
 
 static void do_bitmap_24bpp(deark *c, lctx *d)
@@ -508,22 +523,36 @@ static void do_bitmap_24bpp(deark *c, lctx *d)
 	de_bitmap *img = NULL;
 	i64 i, j;
 	i64 plane;
-	u8 s[4];
+	u8 *rawbuf = NULL;
+	u32 *clrbuf = NULL;
 
-	de_memset(s, 0xff, sizeof(s));
 	img = de_bitmap_create(c, d->width, d->height, d->has_transparency?4:3);
+	if(!de_good_image_dimensions_noerr(c, d->width, d->height)) goto done;
+
+	rawbuf = de_malloc(c, d->width);
+	clrbuf = de_mallocarray(c, d->width, sizeof(u32));
 
 	for(j=0; j<d->height; j++) {
 		for(i=0; i<d->width; i++) {
-			for(plane=0; plane<d->planes; plane++) {
-				s[plane] = dbuf_getbyte(d->unc_pixels, j*d->rowspan + plane*d->rowspan_raw +i);
+			clrbuf[i] = 0xffffffffU;
+		}
+		// Merge each plane into its byte of the color, in the order R, G, B, A.
+		for(plane=0; plane<d->planes && plane<4; plane++) {
+			UI shift = (plane==3) ? 24 : (UI)(16 - 8*plane);
+
+			dbuf_read(d->unc_pixels, rawbuf, j*d->rowspan + plane*d->rowspan_raw, d->width);
+			for(i=0; i<d->width; i++) {
+				clrbuf[i] = (clrbuf[i] & ~(0xffU<<shift)) | ((u32)rawbuf[i]<<shift);
 			}
-			de_bitmap_setpixel_rgba(img, i, j, DE_MAKE_RGBA(s[0], s[1], s[2], s[3]));
 		}
+		de_bitmap_setpixels_rgba(img, 0, j, d->width, clrbuf);
 	}
 
+done:
 	de_bitmap_write_to_file_finfo(img, d->fi, 0);
 	de_bitmap_destroy(img);
+	de_free(c, rawbuf);
+	de_free(c, clrbuf);
 }
 
 static void do_bitmap(deark *c, lctx *d)
@@ -720,17 +749,15 @@ static void de_run_dcx(deark *c, de_module_params *mparams)
 	}
 }
 
-static int de_identify_dcx(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xb1\x68\xde\x3a", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig dcx_sigs[] = {
+	{ 0, "\xb1\x68\xde\x3a", 4, 100 }
+};
 
 void de_module_dcx(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "dcx";
 	mi->desc = "DCX (multi-image PCX)";
 	mi->run_fn = de_run_dcx;
-	mi->identify_fn = de_identify_dcx;
+	mi->sigs = dcx_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(dcx_sigs);
 }
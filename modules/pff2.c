@@ -226,17 +226,15 @@ static void de_run_pff2(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_pff2(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "FILE\x00\x00\x00\x04PFF2", 12))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig pff2_sigs[] = {
+	{ 0, "FILE\x00\x00\x00\x04PFF2", 12, 100 }
+};
 
 void de_module_pff2(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pff2";
 	mi->desc = "PFF2 font";
 	mi->run_fn = de_run_pff2;
-	mi->identify_fn = de_identify_pff2;
+	mi->sigs = pff2_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pff2_sigs);
 }
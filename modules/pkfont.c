@@ -549,17 +549,15 @@ done:
 	de_free(c, d);
 }
 
-static int de_identify_pkfont(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xf7\x59", 2))
-		return 75;
-	return 0;
-}
+static const struct deark_module_sig pkfont_sigs[] = {
+	{ 0, "\xf7\x59", 2, 75 }
+};
 
 void de_module_pkfont(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pkfont";
 	mi->desc = "PK Font";
 	mi->run_fn = de_run_pkfont;
-	mi->identify_fn = de_identify_pkfont;
+	mi->sigs = pkfont_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pkfont_sigs);
 }
@@ -139,19 +139,17 @@ static void de_run_pgx(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_pgx(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PGX", 3))
-		return 90;
-	return 0;
-}
+static const struct deark_module_sig pgx_sigs[] = {
+	{ 0, "PGX", 3, 90 }
+};
 
 void de_module_pgx(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pgx";
 	mi->desc = "Atari Portfolio animation";
 	mi->run_fn = de_run_pgx;
-	mi->identify_fn = de_identify_pgx;
+	mi->sigs = pgx_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pgx_sigs);
 }
 
 // **************************************************************************
@@ -217,18 +215,15 @@ static void de_run_pgc(deark *c, de_module_params *mparams)
 	dbuf_close(unc_pixels);
 }
 
-static int de_identify_pgc(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "PG\x01", 3)) {
-		return 100;
-	}
-	return 0;
-}
+static const struct deark_module_sig pgc_sigs[] = {
+	{ 0, "PG\x01", 3, 100 }
+};
 
 void de_module_pgc(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pgc";
 	mi->desc = "Atari Portfolio Graphics - compressed";
 	mi->run_fn = de_run_pgc;
-	mi->identify_fn = de_identify_pgc;
+	mi->sigs = pgc_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pgc_sigs);
 }
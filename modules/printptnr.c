@@ -257,10 +257,16 @@ static int de_identify_pp_gph(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig pp_gph_sigs[] = {
+	{ 0, "PrintPartner", 12, 0 }
+};
+
 void de_module_pp_gph(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "pp_gph";
 	mi->desc = "PrintPartner .GPH";
 	mi->run_fn = de_run_pp_gph;
 	mi->identify_fn = de_identify_pp_gph;
+	mi->sigs = pp_gph_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(pp_gph_sigs);
 }
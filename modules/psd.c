@@ -4245,12 +4245,18 @@ static int de_identify_ps_gradient(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig ps_gradient_sigs[] = {
+	{ 0, "8BGR", 4, 0 }
+};
+
 void de_module_ps_gradient(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_gradient";
 	mi->desc = "Photoshop Gradient";
 	mi->run_fn = de_run_ps_gradient;
 	mi->identify_fn = de_identify_ps_gradient;
+	mi->sigs = ps_gradient_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(ps_gradient_sigs);
 }
 
 static int de_identify_ps_styles(deark *c)
@@ -4262,12 +4268,18 @@ static int de_identify_ps_styles(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig ps_styles_sigs[] = {
+	{ 2, "8BSL", 4, 0 }
+};
+
 void de_module_ps_styles(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_styles";
 	mi->desc = "Photoshop Styles";
 	mi->run_fn = de_run_ps_styles;
 	mi->identify_fn = de_identify_ps_styles;
+	mi->sigs = ps_styles_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(ps_styles_sigs);
 }
 
 static int de_identify_ps_brush(deark *c)
@@ -4298,12 +4310,18 @@ static int de_identify_ps_csh(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig ps_csh_sigs[] = {
+	{ 0, "cush", 4, 0 }
+};
+
 void de_module_ps_csh(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_csh";
 	mi->desc = "Photoshop Custom Shape";
 	mi->run_fn = de_run_ps_csh;
 	mi->identify_fn = de_identify_ps_csh;
+	mi->sigs = ps_csh_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(ps_csh_sigs);
 }
 
 static int de_identify_ps_pattern(deark *c)
@@ -4315,10 +4333,16 @@ static int de_identify_ps_pattern(deark *c)
 	return 0;
 }
 
+static const struct deark_module_sig ps_pattern_sigs[] = {
+	{ 0, "8BPT", 4, 0 }
+};
+
 void de_module_ps_pattern(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "ps_pattern";
 	mi->desc = "Photoshop Pattern";
 	mi->run_fn = de_run_ps_pattern;
 	mi->identify_fn = de_identify_ps_pattern;
+	mi->sigs = ps_pattern_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(ps_pattern_sigs);
 }
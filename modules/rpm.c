@@ -254,17 +254,15 @@ done:
 	}
 }
 
-static int de_identify_rpm(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\xed\xab\xee\xdb", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig rpm_sigs[] = {
+	{ 0, "\xed\xab\xee\xdb", 4, 100 }
+};
 
 void de_module_rpm(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "rpm";
 	mi->desc = "RPM Package Manager";
 	mi->run_fn = de_run_rpm;
-	mi->identify_fn = de_identify_rpm;
+	mi->sigs = rpm_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(rpm_sigs);
 }
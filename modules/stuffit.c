@@ -525,10 +525,10 @@ static int do_member(deark *c, lctx *d, i64 pos1, i64 *bytes_consumed)
 	md->advf->writefork_cbfn = my_advfile_cbfn;
 	de_advfile_run(md->advf);
 
-	if(md->advf->rsrcfork.fork_exists) {
+	if(md->advf->rsrcfork.fork_exists && !md->advf->rsrcfork.write_skipped) {
 		do_post_decompress_fork(c, d, md, &md->rfork);
 	}
-	if(md->advf->mainfork.fork_exists) {
+	if(md->advf->mainfork.fork_exists && !md->advf->mainfork.write_skipped) {
 		do_post_decompress_fork(c, d, md, &md->dfork);
 	}
 
@@ -370,12 +370,9 @@ done:
 	de_dbg_indent_restore(c, saved_indent_level);
 }
 
-static int de_identify_sunras(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "\x59\xa6\x6a\x95", 4))
-		return 100;
-	return 0;
-}
+static const struct deark_module_sig sunras_sigs[] = {
+	{ 0, "\x59\xa6\x6a\x95", 4, 100 }
+};
 
 static void de_help_sunras(deark *c)
 {
@@ -389,6 +386,7 @@ void de_module_sunras(deark *c, struct deark_module_info *mi)
 	mi->id = "sunras";
 	mi->desc = "Sun Raster";
 	mi->run_fn = de_run_sunras;
-	mi->identify_fn = de_identify_sunras;
+	mi->sigs = sunras_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(sunras_sigs);
 	mi->help_fn = de_help_sunras;
 }
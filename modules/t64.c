@@ -129,16 +129,15 @@ static void de_run_t64(deark *c, de_module_params *mparams)
 	de_free(c, d);
 }
 
-static int de_identify_t64(deark *c)
-{
-	if(!dbuf_memcmp(c->infile, 0, "C64", 3)) return 80;
-	return 0;
-}
+static const struct deark_module_sig t64_sigs[] = {
+	{ 0, "C64", 3, 80 }
+};
 
 void de_module_t64(deark *c, struct deark_module_info *mi)
 {
 	mi->id = "t64";
 	mi->desc = "T64 (C64 tape format)";
 	mi->run_fn = de_run_t64;
-	mi->identify_fn = de_identify_t64;
+	mi->sigs = t64_sigs;
+	mi->num_sigs = DE_ARRAYCOUNT(t64_sigs);
 }
@@ -715,7 +715,14 @@ static int read_member(deark *c, lctx *d, i64 pos1, i64 *bytes_consumed_member)
 
 	if(pmd->file_data_pos + pmd->filesize > c->infile->len) goto done;
 
+	if(!md->is_dir && !(md->is_symlink && pmd->filesize==0)) {
+		md->fi->len_known = 1;
+		md->fi->len = pmd->filesize;
+	}
 	outf = dbuf_create_output_file(c, NULL, md->fi, 0);
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	// If a symlink has no data, write the 'linkname' field instead.
 	if(md->is_symlink && pmd->filesize==0) {
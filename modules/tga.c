@@ -58,9 +58,9 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 {
 	de_bitmap *img = NULL;
 	i64 i, j;
-	u8 b;
 	u32 clr;
-	u8 a;
+	u8 *rawbuf = NULL;
+	u32 *clrbuf = NULL;
 	i64 rowspan;
 	int output_bypp;
 	unsigned int getrgbflags;
@@ -90,6 +90,9 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 		getrgbflags = DE_GETRGBFLAG_BGR;
 
 	img = de_bitmap_create(c, imginfo->width, imginfo->height, output_bypp);
+	if(!de_good_image_dimensions_noerr(c, imginfo->width, imginfo->height)) goto done;
+	rawbuf = de_malloc(c, rowspan);
+	clrbuf = de_mallocarray(c, imginfo->width, sizeof(u32));
 
 	switch(d->interleave_mode) {
 	case 1: interleave_stride = 2; break;
@@ -116,46 +119,55 @@ static void do_decode_image_default(deark *c, lctx *d, struct tgaimginfo *imginf
 			cur_rownum = interleave_pass;
 		}
 
+		if(d->pixel_depth==1) {
+			de_convert_row_bilevel(unc_pixels, j*rowspan, img, j_adj, 0);
+			continue;
+		}
+
+		dbuf_read(unc_pixels, rawbuf, j*rowspan, rowspan);
+
 		for(i=0; i<imginfo->width; i++) {
 			i64 i_adj;
+			const u8 *p = &rawbuf[i*d->bytes_per_pixel];
 
 			if(d->right_to_left)
 				i_adj = imginfo->width-1-i;
 			else
 				i_adj = i;
 
-			if(d->pixel_depth==1) {
-				de_convert_row_bilevel(unc_pixels, j*rowspan, img, j_adj, 0);
-			}
-			else if(d->color_type==TGA_CLRTYPE_TRUECOLOR && (d->pixel_depth==15 || d->pixel_depth==16)) {
-				clr = (u32)dbuf_getu16le(unc_pixels, j*rowspan + i*d->bytes_per_pixel);
-				clr = de_rgb555_to_888(clr);
-				de_bitmap_setpixel_rgb(img, i_adj, j_adj, clr);
+			if(d->color_type==TGA_CLRTYPE_TRUECOLOR && (d->pixel_depth==15 || d->pixel_depth==16)) {
+				clr = de_rgb555_to_888((u32)de_getu16le_direct(p));
 			}
 			else if(d->color_type==TGA_CLRTYPE_TRUECOLOR) {
-				clr = dbuf_getRGB(unc_pixels, j*rowspan + i*d->bytes_per_pixel, getrgbflags);
+				if(getrgbflags & DE_GETRGBFLAG_BGR)
+					clr = DE_MAKE_RGB(p[2], p[1], p[0]);
+				else
+					clr = DE_MAKE_RGB(p[0], p[1], p[2]);
 				if(d->has_alpha_channel) {
-					a = dbuf_getbyte(unc_pixels, j*rowspan + i*d->bytes_per_pixel+3);
-					de_bitmap_setpixel_rgba(img, i_adj, j_adj, DE_SET_ALPHA(clr, a));
-				}
-				else {
-					de_bitmap_setpixel_rgb(img, i_adj, j_adj, clr);
+					clr = DE_SET_ALPHA(clr, p[3]);
 				}
 			}
 			else if(d->color_type==TGA_CLRTYPE_GRAYSCALE) {
-				b = dbuf_getbyte(unc_pixels, j*rowspan + i*d->bytes_per_pixel);
-				de_bitmap_setpixel_gray(img, i_adj, j_adj, b);
+				clr = DE_MAKE_GRAY((u32)p[0]);
 			}
 			else if(d->color_type==TGA_CLRTYPE_PALETTE) {
-				b = dbuf_getbyte(unc_pixels, j*rowspan + i*d->bytes_per_pixel);
-				de_bitmap_setpixel_rgb(img, i_adj, j_adj, d->pal[(unsigned int)b]);
+				clr = d->pal[(unsigned int)p[0]];
+			}
+			else {
+				clr = 0;
 			}
+			clrbuf[i_adj] = clr;
 		}
+
+		de_bitmap_setpixels_rgba(img, 0, j_adj, imginfo->width, clrbuf);
 	}
 
+done:
 	de_bitmap_write_to_file_finfo(img, fi, createflags);
 
 	de_bitmap_destroy(img);
+	de_free(c, rawbuf);
+	de_free(c, clrbuf);
 }
 
 static void do_decode_image(deark *c, lctx *d, struct tgaimginfo *imginfo, dbuf *unc_pixels,
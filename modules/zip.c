@@ -955,11 +955,18 @@ static void do_extract_file(deark *c, lctx *d, struct member_data *md)
 	else if(md->is_nonexecutable) {
 		fi->mode_flags |= DE_MODEFLAG_NONEXE;
 	}
+	if(!md->is_dir) {
+		fi->len_known = 1;
+		fi->len = md->uncmpr_size;
+	}
 
 	outf = dbuf_create_output_file(c, NULL, fi, 0);
 	if(md->is_dir) {
 		goto done;
 	}
+	if(dbuf_is_discarded(outf)) {
+		goto done;
+	}
 
 	dbuf_set_writelistener(outf, our_writelistener_cb, (void*)md);
 	md->crco = d->crco;
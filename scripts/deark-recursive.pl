@@ -6,6 +6,11 @@
 # It is normal for error messages to be printed, when unsupported formats are
 # extracted.
 # This script is quick and dirty. Use at your own risk.
+# Note: Deark's "-opt recurse" option does much the same thing internally,
+# in a single process. Its output files are named differently (e.g.
+# "output.000.inner.tar.001.png"), it only extracts auxiliary files if -a is
+# used, and it has limits on the nesting depth and the total size of the
+# files it looks inside.
 # Terms of use: Public domain
 # By Jason Summers, 2018
 use strict;
@@ -90,11 +90,16 @@ struct image_scan_results {
 };
 
 // Scan the image's pixels, and report whether any are transparent, etc.
+// This works a row at a time, using loops with no branches (that the
+// compiler can vectorize), and then checks whether it can stop early.
 static void scan_image(de_bitmap *img, struct image_scan_results *isres)
 {
-	i64 i, j;
-	u32 clr;
-	u8 a, r, g, b;
+	i64 j, k;
+	i64 rowspan;
+	const u8 *row;
+	u8 a_and; // All alpha values in the row, ANDed together
+	u8 a_or; // All alpha values in the row, ORed together
+	u8 clrdiff; // Nonzero if some visible pixel in the row is not gray
 
 	de_zeromem(isres, sizeof(struct image_scan_results));
 	if(img->bytes_per_pixel==1) {
@@ -102,31 +107,47 @@ static void scan_image(de_bitmap *img, struct image_scan_results *isres)
 		isres->has_visible_pixels = 1;
 		return;
 	}
+	if(!img->bitmap) return;
+
+	rowspan = img->width * img->bytes_per_pixel;
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			clr = de_bitmap_getpixel(img, i, j);
-			// TODO: Optimize these tests. We check for too many things we
-			// already know the answer to.
-			a = DE_COLOR_A(clr);
-			r = DE_COLOR_R(clr);
-			g = DE_COLOR_G(clr);
-			b = DE_COLOR_B(clr);
-			if(!isres->has_visible_pixels && a!=0) {
-				isres->has_visible_pixels = 1;
+		row = &img->bitmap[j*rowspan];
+		a_and = 0xff;
+		a_or = 0;
+		clrdiff = 0;
+
+		switch(img->bytes_per_pixel) {
+		case 4:
+			for(k=0; k<img->width; k++) {
+				u8 a = row[4*k+3];
+				u8 vismask = (u8)(0 - (u8)(a!=0));
+
+				a_and &= a;
+				a_or |= a;
+				clrdiff |= (u8)(((row[4*k]^row[4*k+1]) | (row[4*k]^row[4*k+2])) & vismask);
 			}
-			if(!isres->has_trns && a<255) {
-				isres->has_trns = 1;
+			break;
+		case 3:
+			a_or = 0xff;
+			for(k=0; k<img->width; k++) {
+				clrdiff |= (u8)((row[3*k]^row[3*k+1]) | (row[3*k]^row[3*k+2]));
 			}
-			if(!isres->has_color && img->bytes_per_pixel>=3 &&
-				((g!=r || b!=r) && a!=0) )
-			{
-				isres->has_color = 1;
+			break;
+		case 2:
+			for(k=0; k<img->width; k++) {
+				a_and &= row[2*k+1];
+				a_or |= row[2*k+1];
 			}
+			break;
 		}
 
+		if(a_or!=0) isres->has_visible_pixels = 1;
+		if(a_and!=0xff) isres->has_trns = 1;
+		if(clrdiff!=0) isres->has_color = 1;
+
 		// After each row, test whether we've learned everything we can learn
 		// about this image.
-		if((isres->has_trns || img->bytes_per_pixel==1 || img->bytes_per_pixel==3) &&
+		if((isres->has_trns || img->bytes_per_pixel==3) &&
 			(isres->has_visible_pixels) &&
 			(isres->has_color || img->bytes_per_pixel<=2))
 		{
@@ -148,6 +169,50 @@ static de_bitmap *de_bitmap_clone_noalloc(de_bitmap *img1)
 	return img2;
 }
 
+// Copy the pixels of img1 to img2, which has the same dimensions, but fewer
+// bytes per pixel, as decided by get_optimized_image().
+// This is equivalent to de_bitmap_copy_rect(), but a lot faster.
+static void reduce_image_depth(de_bitmap *img1, de_bitmap *img2)
+{
+	i64 j, k;
+	i64 w = img1->width;
+	int bypp1 = img1->bytes_per_pixel;
+	int bypp2 = img2->bytes_per_pixel;
+	int gidx; // Offset of the gray (green) sample in img1's pixels
+	const u8 *src;
+	u8 *dst;
+
+	de_bitmap_alloc_pixels(img2);
+	gidx = (bypp1>=3) ? 1 : 0;
+
+	for(j=0; j<img1->height; j++) {
+		src = &img1->bitmap[j*w*bypp1];
+		dst = &img2->bitmap[j*w*bypp2];
+
+		if(bypp1==4 && bypp2==3) {
+			for(k=0; k<w; k++) {
+				dst[3*k] = src[4*k];
+				dst[3*k+1] = src[4*k+1];
+				dst[3*k+2] = src[4*k+2];
+			}
+		}
+		else if(bypp1==4 && bypp2==2) {
+			for(k=0; k<w; k++) {
+				dst[2*k] = src[4*k+1];
+				dst[2*k+1] = src[4*k+3];
+			}
+		}
+		else if(bypp2==1) {
+			for(k=0; k<w; k++) {
+				dst[k] = src[bypp1*k+gidx];
+			}
+		}
+		else {
+			de_bitmap_copy_rect(img1, img2, 0, j, w, 1, 0, j, 0);
+		}
+	}
+}
+
 // Returns NULL if there's no need to optimize the image
 static de_bitmap *get_optimized_image(de_bitmap *img1)
 {
@@ -155,6 +220,7 @@ static de_bitmap *get_optimized_image(de_bitmap *img1)
 	int opt_bytes_per_pixel;
 	de_bitmap *optimg;
 
+	if(img1->bytes_per_pixel==1) return NULL;
 	scan_image(img1, &isres);
 	opt_bytes_per_pixel = isres.has_color ? 3 : 1;
 	if(isres.has_trns) opt_bytes_per_pixel++;
@@ -165,7 +231,7 @@ static de_bitmap *get_optimized_image(de_bitmap *img1)
 
 	optimg = de_bitmap_clone_noalloc(img1);
 	optimg->bytes_per_pixel = opt_bytes_per_pixel;
-	de_bitmap_copy_rect(img1, optimg, 0, 0, img1->width, img1->height, 0, 0, 0);
+	reduce_image_depth(img1, optimg);
 	return optimg;
 }
 
@@ -184,17 +250,28 @@ void de_bitmap_write_to_file_finfo(de_bitmap *img, de_finfo *fi,
 
 	if(!img->bitmap) de_bitmap_alloc_pixels(img);
 
-	if(createflags & DE_CREATEFLAG_OPT_IMAGE) {
-		// This should probably be the default, but our optimization routine
-		// isn't very efficient, and wouldn't change anything in most cases.
+	// Use the fewest channels that can represent the image (e.g. remove an
+	// alpha channel that is always opaque), so the PNG file is smaller.
+	if(c->debug_level>=3) {
+		i64 t0, t1;
+
+		t0 = de_get_highres_time_ns();
+		optimg = get_optimized_image(img);
+		t1 = de_get_highres_time_ns() - t0;
+		de_dbg3(c, "image analysis: %.3f ms (%.3f ms/megapixel)",
+			(double)t1/1000000.0,
+			(double)t1/(double)(img->width*img->height));
+	}
+	else {
 		optimg = get_optimized_image(img);
-		if(optimg) {
-			de_dbg3(c, "reducing image depth (%d->%d)", img->bytes_per_pixel,
-				optimg->bytes_per_pixel);
-		}
+	}
+	if(optimg) {
+		de_dbg3(c, "reducing image depth (%d->%d)", img->bytes_per_pixel,
+			optimg->bytes_per_pixel);
 	}
 
-	f = dbuf_create_output_file(c, "png", fi, createflags);
+	// There's nothing to find inside a PNG file that we made ourselves.
+	f = dbuf_create_output_file(c, "png", fi, createflags|DE_CREATEFLAG_NO_RECURSE);
 	if(optimg) {
 		de_write_png(c, optimg, f);
 	}
@@ -330,6 +407,150 @@ void de_bitmap_setpixel_rgba(de_bitmap *img, i64 x, i64 y,
 	}
 }
 
+// Returns a pointer to pixel (x,y), after making sure the pixels are
+// allocated, and clipping n (the number of pixels the caller wants to set in
+// this row) to the image width.
+// Returns NULL if there is nothing to do.
+static u8 *get_pixel_ptr_for_row(de_bitmap *img, i64 x, i64 y, i64 *pn)
+{
+	if(!img->bitmap) de_bitmap_alloc_pixels(img);
+	if(!img->bitmap) return NULL;
+	if(x<0 || y<0 || x>=img->width || y>=img->height) return NULL;
+	if(*pn > img->width - x) *pn = img->width - x;
+	if(*pn < 1) return NULL;
+	return &img->bitmap[(img->width*img->bytes_per_pixel)*y + img->bytes_per_pixel*x];
+}
+
+// Set n pixels of row y, starting at x, to the given colors.
+// Equivalent to, but faster than, calling de_bitmap_setpixel_rgba() for
+// each pixel.
+void de_bitmap_setpixels_rgba(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u32 *clrs)
+{
+	u8 *p;
+	i64 k;
+
+	p = get_pixel_ptr_for_row(img, x, y, &n);
+	if(!p) return;
+
+	switch(img->bytes_per_pixel) {
+	case 4:
+		for(k=0; k<n; k++) {
+			p[0] = DE_COLOR_R(clrs[k]);
+			p[1] = DE_COLOR_G(clrs[k]);
+			p[2] = DE_COLOR_B(clrs[k]);
+			p[3] = DE_COLOR_A(clrs[k]);
+			p += 4;
+		}
+		break;
+	case 3:
+		for(k=0; k<n; k++) {
+			p[0] = DE_COLOR_R(clrs[k]);
+			p[1] = DE_COLOR_G(clrs[k]);
+			p[2] = DE_COLOR_B(clrs[k]);
+			p += 3;
+		}
+		break;
+	case 2:
+		for(k=0; k<n; k++) {
+			p[0] = DE_COLOR_G(clrs[k]);
+			p[1] = DE_COLOR_A(clrs[k]);
+			p += 2;
+		}
+		break;
+	case 1:
+		for(k=0; k<n; k++) {
+			p[k] = DE_COLOR_G(clrs[k]);
+		}
+		break;
+	}
+}
+
+// Like de_bitmap_setpixels_rgba(), but the colors are given as indices into
+// pal. It's the caller's job to make sure every index is valid.
+void de_bitmap_setpixels_paletted(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u8 *idx, const u32 *pal)
+{
+	u8 *p;
+	i64 k;
+	u32 clr;
+
+	p = get_pixel_ptr_for_row(img, x, y, &n);
+	if(!p) return;
+
+	switch(img->bytes_per_pixel) {
+	case 4:
+		for(k=0; k<n; k++) {
+			clr = pal[idx[k]];
+			p[0] = DE_COLOR_R(clr);
+			p[1] = DE_COLOR_G(clr);
+			p[2] = DE_COLOR_B(clr);
+			p[3] = DE_COLOR_A(clr);
+			p += 4;
+		}
+		break;
+	case 3:
+		for(k=0; k<n; k++) {
+			clr = pal[idx[k]];
+			p[0] = DE_COLOR_R(clr);
+			p[1] = DE_COLOR_G(clr);
+			p[2] = DE_COLOR_B(clr);
+			p += 3;
+		}
+		break;
+	case 2:
+		for(k=0; k<n; k++) {
+			clr = pal[idx[k]];
+			p[0] = DE_COLOR_G(clr);
+			p[1] = DE_COLOR_A(clr);
+			p += 2;
+		}
+		break;
+	case 1:
+		for(k=0; k<n; k++) {
+			p[k] = DE_COLOR_G(pal[idx[k]]);
+		}
+		break;
+	}
+}
+
+// Like calling de_bitmap_setpixel_gray() for each pixel.
+void de_bitmap_setpixels_gray(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u8 *samples)
+{
+	u8 *p;
+	i64 k;
+
+	p = get_pixel_ptr_for_row(img, x, y, &n);
+	if(!p) return;
+
+	switch(img->bytes_per_pixel) {
+	case 4:
+		for(k=0; k<n; k++) {
+			p[0] = p[1] = p[2] = samples[k];
+			p[3] = 255;
+			p += 4;
+		}
+		break;
+	case 3:
+		for(k=0; k<n; k++) {
+			p[0] = p[1] = p[2] = samples[k];
+			p += 3;
+		}
+		break;
+	case 2:
+		for(k=0; k<n; k++) {
+			p[0] = samples[k];
+			p[1] = 255;
+			p += 2;
+		}
+		break;
+	case 1:
+		de_memcpy(p, samples, (size_t)n);
+		break;
+	}
+}
+
 u32 de_bitmap_getpixel(de_bitmap *img, i64 x, i64 y)
 {
 	i64 pos;
@@ -477,29 +698,140 @@ u8 de_get_bits_symbol2(dbuf *f, int nbits, i64 bytepos, i64 bitpos)
 	return (b0<<bits_in_second_byte) | (b1>>(8-bits_in_second_byte));
 }
 
-void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
-	i64 rownum, unsigned int flags)
+// Unpack n symbols of bps bits each (bps = 1, 2, 4, or 8) from src, to one
+// byte per symbol in dst. src must contain at least (n*bps+7)/8 bytes.
+// flags: DE_CVTF_LSBFIRST
+void de_unpack_pixels(const u8 *src, i64 bps, i64 n, u8 *dst, unsigned int flags)
 {
 	i64 i;
-	u8 x;
+	i64 nfullbytes;
 	u8 b;
-	u8 black, white;
+	int lsbfirst = (flags & DE_CVTF_LSBFIRST) ? 1 : 0;
 
-	if(flags & DE_CVTF_WHITEISZERO) {
-		white = 0; black = 255;
+	if(bps==8) {
+		de_memcpy(dst, src, (size_t)n);
+		return;
+	}
+	if(bps!=1 && bps!=2 && bps!=4) return;
+
+	// Bytes whose every symbol we need
+	nfullbytes = (n*bps)/8;
+
+	if(bps==1 && !lsbfirst) {
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b>>7;
+			dst[1] = (b>>6)&0x01;
+			dst[2] = (b>>5)&0x01;
+			dst[3] = (b>>4)&0x01;
+			dst[4] = (b>>3)&0x01;
+			dst[5] = (b>>2)&0x01;
+			dst[6] = (b>>1)&0x01;
+			dst[7] = b&0x01;
+			dst += 8;
+		}
+	}
+	else if(bps==1) {
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b&0x01;
+			dst[1] = (b>>1)&0x01;
+			dst[2] = (b>>2)&0x01;
+			dst[3] = (b>>3)&0x01;
+			dst[4] = (b>>4)&0x01;
+			dst[5] = (b>>5)&0x01;
+			dst[6] = (b>>6)&0x01;
+			dst[7] = b>>7;
+			dst += 8;
+		}
+	}
+	else if(bps==2 && !lsbfirst) {
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b>>6;
+			dst[1] = (b>>4)&0x03;
+			dst[2] = (b>>2)&0x03;
+			dst[3] = b&0x03;
+			dst += 4;
+		}
+	}
+	else if(bps==2) {
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b&0x03;
+			dst[1] = (b>>2)&0x03;
+			dst[2] = (b>>4)&0x03;
+			dst[3] = b>>6;
+			dst += 4;
+		}
+	}
+	else if(!lsbfirst) { // 4
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b>>4;
+			dst[1] = b&0x0f;
+			dst += 2;
+		}
 	}
 	else {
-		black = 0; white = 255;
+		for(i=0; i<nfullbytes; i++) {
+			b = src[i];
+			dst[0] = b&0x0f;
+			dst[1] = b>>4;
+			dst += 2;
+		}
 	}
 
-	for(i=0; i<img->width; i++) {
-		b = dbuf_getbyte(f, fpos + i/8);
-		if(flags & DE_CVTF_LSBFIRST)
-			x = (b >> (i%8)) & 0x01;
+	// Any symbols in the last, partially-used, byte
+	for(i=nfullbytes*(8/bps); i<n; i++) {
+		UI shift;
+
+		b = src[(i*bps)/8];
+		if(lsbfirst)
+			shift = (UI)((i*bps)%8);
 		else
-			x = (b >> (7 - i%8)) & 0x01;
-		de_bitmap_setpixel_gray(img, i, rownum, x ? white : black);
+			shift = (UI)(8 - bps - (i*bps)%8);
+		*(dst++) = (b >> shift) & (u8)((1U<<bps)-1);
+	}
+}
+
+// Number of pixels the row conversion functions process at a time, using
+// buffers on the stack. Must be a multiple of 8.
+#define DE_CVT_CHUNK_PIXELS 1024
+
+void de_convert_row_paletted(dbuf *f, i64 fpos, i64 bpp, const u32 *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags)
+{
+	i64 x;
+	i64 n;
+	u8 rawbuf[DE_CVT_CHUNK_PIXELS];
+	u8 idxbuf[DE_CVT_CHUNK_PIXELS];
+
+	if(bpp!=1 && bpp!=2 && bpp!=4 && bpp!=8) return;
+
+	for(x=0; x<img->width; x+=n) {
+		n = de_min_int(img->width - x, DE_CVT_CHUNK_PIXELS);
+		dbuf_read(f, rawbuf, fpos + (x*bpp)/8, (n*bpp+7)/8);
+		de_unpack_pixels(rawbuf, bpp, n, idxbuf, flags);
+		de_bitmap_setpixels_paletted(img, x, rownum, n, idxbuf, pal);
+	}
+}
+
+void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
+	i64 rownum, unsigned int flags)
+{
+	u32 pal[2];
+
+	if(flags & DE_CVTF_WHITEISZERO) {
+		pal[0] = DE_STOCKCOLOR_WHITE;
+		pal[1] = DE_STOCKCOLOR_BLACK;
 	}
+	else {
+		pal[0] = DE_STOCKCOLOR_BLACK;
+		pal[1] = DE_STOCKCOLOR_WHITE;
+	}
+
+	de_convert_row_paletted(f, fpos, 1, pal, img, rownum, flags);
 }
 
 void de_convert_image_bilevel(dbuf *f, i64 fpos, i64 rowspan,
@@ -547,31 +879,72 @@ void de_convert_image_paletted(dbuf *f, i64 fpos,
 	i64 bpp, i64 rowspan, const u32 *pal,
 	de_bitmap *img, unsigned int flags)
 {
-	i64 i, j;
-	unsigned int palent;
+	i64 j;
 
 	if(bpp!=1 && bpp!=2 && bpp!=4 && bpp!=8) return;
 	if(!de_good_image_dimensions_noerr(f->c, img->width, img->height)) return;
 
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			palent = (unsigned int)de_get_bits_symbol(f, bpp, fpos+j*rowspan, i);
-			de_bitmap_setpixel_rgba(img, i, j, pal[palent]);
+		// (flags are not passed along; this function has always used
+		// MSB-first order.)
+		de_convert_row_paletted(f, fpos+j*rowspan, bpp, pal, img, j, 0);
+	}
+}
+
+// Convert a row of 24-bit RGB pixels, each pixelspan bytes apart.
+// flags: DE_GETRGBFLAG_*
+void de_convert_row_rgb(dbuf *f, i64 fpos, i64 pixelspan,
+	de_bitmap *img, i64 rownum, unsigned int flags)
+{
+	i64 x;
+	i64 n;
+	i64 k;
+	const u8 *p;
+	u8 rawbuf[DE_CVT_CHUNK_PIXELS*4];
+	u32 clrbuf[DE_CVT_CHUNK_PIXELS];
+	i64 chunk_pixels;
+
+	if(pixelspan<3) return;
+
+	// Keep the raw data for a chunk within our buffer
+	chunk_pixels = (i64)sizeof(rawbuf) / pixelspan;
+	if(chunk_pixels<1) {
+		// Unusual pixelspan; do it the slow way
+		for(x=0; x<img->width; x++) {
+			de_bitmap_setpixel_rgb(img, x, rownum,
+				dbuf_getRGB(f, fpos + x*pixelspan, flags));
+		}
+		return;
+	}
+	if(chunk_pixels>DE_CVT_CHUNK_PIXELS) chunk_pixels = DE_CVT_CHUNK_PIXELS;
+
+	for(x=0; x<img->width; x+=n) {
+		n = de_min_int(img->width - x, chunk_pixels);
+		dbuf_read(f, rawbuf, fpos + x*pixelspan, (n-1)*pixelspan + 3);
+		p = rawbuf;
+		if(flags & DE_GETRGBFLAG_BGR) {
+			for(k=0; k<n; k++) {
+				clrbuf[k] = DE_MAKE_RGB(p[2], p[1], p[0]);
+				p += pixelspan;
+			}
 		}
+		else {
+			for(k=0; k<n; k++) {
+				clrbuf[k] = DE_MAKE_RGB(p[0], p[1], p[2]);
+				p += pixelspan;
+			}
+		}
+		de_bitmap_setpixels_rgba(img, x, rownum, n, clrbuf);
 	}
 }
 
 void de_convert_image_rgb(dbuf *f, i64 fpos,
 	i64 rowspan, i64 pixelspan, de_bitmap *img, unsigned int flags)
 {
-	i64 i, j;
-	u32 clr;
+	i64 j;
 
 	for(j=0; j<img->height; j++) {
-		for(i=0; i<img->width; i++) {
-			clr = dbuf_getRGB(f, fpos + j*rowspan + i*pixelspan, flags);
-			de_bitmap_setpixel_rgb(img, i, j, clr);
-		}
+		de_convert_row_rgb(f, fpos + j*rowspan, pixelspan, img, j, flags);
 	}
 }
 
@@ -644,8 +1017,8 @@ void de_bitmap_apply_mask(de_bitmap *fg, de_bitmap *mask,
 	}
 }
 
-// Note: This function's features overlap with the DE_CREATEFLAG_OPT_IMAGE
-//  flag supported by de_bitmap_write_to_file().
+// Note: This function's features overlap with the image optimization done by
+//  de_bitmap_write_to_file().
 // If the image is 100% opaque, remove the alpha channel.
 // Otherwise do nothing.
 // flags:
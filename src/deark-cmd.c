@@ -52,6 +52,17 @@ struct cmdctx {
 	int option_k_level; // Use input filename in output filenames
 	int option_ka_level; // Use input filename in output archive filenames
 	u8 set_MAXFILES;
+	u8 noinfo;
+
+	// Batch mode: More than one input file, processed one after another.
+	int batch_mode;
+	int num_inputs;
+	int inputs_alloc;
+	char **inputs;
+	int input_idx;
+	int num_jobs;
+	const char *filelist_filename;
+	int filelist_from_stdin;
 
 	int to_stdout;
 	int to_zip;
@@ -407,7 +418,7 @@ enum opt_id_enum {
  DE_OPT_MAXFILESIZE, DE_OPT_MAXTOTALSIZE, DE_OPT_MAXIMGDIM,
  DE_OPT_PRINTMODULES, DE_OPT_DPREFIX, DE_OPT_EXTRLIST,
  DE_OPT_ONLYMODS, DE_OPT_DISABLEMODS, DE_OPT_ONLYDETECT, DE_OPT_NODETECT,
- DE_OPT_COLORMODE
+ DE_OPT_COLORMODE, DE_OPT_FILELIST, DE_OPT_FILELISTFROMSTDIN, DE_OPT_JOBS
 };
 
 struct opt_struct {
@@ -445,6 +456,7 @@ struct opt_struct option_array[] = {
 	{ "tostdout",     DE_OPT_TOSTDOUT,     0 },
 	{ "msgstostderr", DE_OPT_MSGSTOSTDERR, 0 },
 	{ "fromstdin",    DE_OPT_FROMSTDIN,    0 },
+	{ "filelistfromstdin", DE_OPT_FILELISTFROMSTDIN, 0 },
 	{ "color",        DE_OPT_COLOR,        0 },
 	{ "k",            DE_OPT_K,            0 },
 	{ "k2",           DE_OPT_K2,           0 },
@@ -459,6 +471,8 @@ struct opt_struct option_array[] = {
 	{ "opt",          DE_OPT_EXTOPT,       1 },
 	{ "file",         DE_OPT_FILE,         1 },
 	{ "file2",        DE_OPT_FILE2,        1 },
+	{ "filelist",     DE_OPT_FILELIST,     1 },
+	{ "j",            DE_OPT_JOBS,         1 },
 	{ "inenc",        DE_OPT_INENC,        1 },
 	{ "intz",         DE_OPT_INTZ,         1 },
 	{ "start",        DE_OPT_START,        1 },
@@ -535,6 +549,7 @@ static void set_output_basename(struct cmdctx *cc)
 {
 	const char *outputbasefn = cc->base_output_filename; // default, could be NULL
 	const char *outdirname;
+	char *batchbasefn = NULL;
 	unsigned int flags = 0;
 
 	if(cc->option_k_level && cc->input_filename) {
@@ -553,6 +568,18 @@ static void set_output_basename(struct cmdctx *cc)
 			outputbasefn = cc->input_filename;
 		}
 	}
+	else if(cc->batch_mode) {
+		size_t batchbasefn_len;
+
+		// Make the output filenames unique to each input file, by appending
+		// the input file number: "output.1.000.png", etc.
+		if(!outputbasefn) outputbasefn = "output";
+		batchbasefn_len = strlen(outputbasefn) + 24;
+		batchbasefn = de_malloc(cc->c, (i64)batchbasefn_len);
+		de_snprintf(batchbasefn, batchbasefn_len, "%s.%d", outputbasefn,
+			cc->input_idx+1);
+		outputbasefn = batchbasefn;
+	}
 
 	if(cc->to_zip || cc->to_tar) {
 		// In this case, -od refers to the archive filename, not to the base
@@ -568,6 +595,7 @@ static void set_output_basename(struct cmdctx *cc)
 	}
 
 	de_set_base_output_filename(cc->c, outdirname, outputbasefn, flags);
+	de_free(cc->c, batchbasefn);
 }
 
 static void set_output_archive_name(struct cmdctx *cc)
@@ -605,6 +633,84 @@ static void set_output_archive_name(struct cmdctx *cc)
 	de_set_output_archive_filename(cc->c, cc->output_dirname, arcfn, flags);
 }
 
+static void add_input_filename(struct cmdctx *cc, const char *fn)
+{
+	if(cc->num_inputs >= cc->inputs_alloc) {
+		int new_alloc;
+
+		new_alloc = cc->inputs_alloc ? cc->inputs_alloc*2 : 8;
+		cc->inputs = de_reallocarray(cc->c, cc->inputs, cc->inputs_alloc,
+			sizeof(char*), new_alloc);
+		cc->inputs_alloc = new_alloc;
+	}
+	cc->inputs[cc->num_inputs++] = de_strdup(cc->c, fn);
+}
+
+static void filelist_cbfn(deark *c, void *userdata, const char *fn)
+{
+	add_input_filename((struct cmdctx*)userdata, fn);
+}
+
+static void free_input_filenames(struct cmdctx *cc)
+{
+	int i;
+
+	for(i=0; i<cc->num_inputs; i++) {
+		de_free(cc->c, cc->inputs[i]);
+	}
+	de_free(cc->c, cc->inputs);
+	cc->inputs = NULL;
+	cc->num_inputs = 0;
+}
+
+// Sets cc->batch_mode if appropriate, and checks for options that don't work
+// with it.
+static void setup_batch_mode(deark *c, struct cmdctx *cc)
+{
+	if(cc->filelist_filename || cc->filelist_from_stdin) {
+		if(cc->filelist_from_stdin && cc->from_stdin) {
+			de_puts(c, DE_MSGTYPE_MESSAGE,
+				"Error: -filelistfromstdin is incompatible with -fromstdin\n");
+			cc->error_flag = 1;
+			return;
+		}
+		if(!de_read_filename_list(c,
+			cc->filelist_from_stdin ? NULL : cc->filelist_filename,
+			filelist_cbfn, (void*)cc))
+		{
+			cc->error_flag = 1;
+			return;
+		}
+		cc->batch_mode = 1;
+	}
+	else if(cc->num_inputs>1) {
+		cc->batch_mode = 1;
+	}
+	else if(cc->num_inputs==1) {
+		cc->input_filename = cc->inputs[0];
+		de_set_input_filename(c, cc->input_filename);
+	}
+
+	if(!cc->batch_mode) return;
+
+	if(cc->from_stdin) {
+		de_puts(c, DE_MSGTYPE_MESSAGE,
+			"Error: -fromstdin can't be used with multiple input files\n");
+		cc->error_flag = 1;
+	}
+	else if(cc->to_stdout && !cc->to_zip && !cc->to_tar) {
+		de_puts(c, DE_MSGTYPE_MESSAGE,
+			"Error: -tostdout can't be used with multiple input files, "
+			"unless -zip is used\n");
+		cc->error_flag = 1;
+	}
+	else if(cc->option_ka_level) {
+		de_puts(c, DE_MSGTYPE_MESSAGE,
+			"Error: -ka can't be used with multiple input files\n");
+		cc->error_flag = 1;
+	}
+}
+
 static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 {
 	int i;
@@ -654,6 +760,7 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				break;
 			case DE_OPT_NOINFO:
 				de_set_infomessages(c, 0);
+				cc->noinfo = 1;
 				break;
 			case DE_OPT_NOWARN:
 				de_set_warnings(c, 0);
@@ -684,6 +791,7 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 			case DE_OPT_Q:
 				de_set_infomessages(c, 0);
 				de_set_warnings(c, 0);
+				cc->noinfo = 1;
 				break;
 			case DE_OPT_VERSION:
 				cc->special_command_flag = 1;
@@ -736,6 +844,9 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				de_set_input_style(c, DE_INPUTSTYLE_STDIN);
 				cc->from_stdin = 1;
 				break;
+			case DE_OPT_FILELISTFROMSTDIN:
+				cc->filelist_from_stdin = 1;
+				break;
 			case DE_OPT_COLOR:
 				colormode_opt(cc, "auto");
 				break;
@@ -765,8 +876,13 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 				set_ext_option(c, cc, argv[i+1]);
 				break;
 			case DE_OPT_FILE:
-				cc->input_filename = argv[i+1];
-				de_set_input_filename(c, cc->input_filename);
+				add_input_filename(cc, argv[i+1]);
+				break;
+			case DE_OPT_FILELIST:
+				cc->filelist_filename = argv[i+1];
+				break;
+			case DE_OPT_JOBS:
+				cc->num_jobs = de_atoi(argv[i+1]);
 				break;
 			case DE_OPT_FILE2:
 				de_set_ext_option(c, "file2", argv[i+1]);
@@ -857,18 +973,16 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 			i += opt->extra_args;
 		}
 		else {
-			if(cc->input_filename) {
-				cc->error_flag = 1;
-				cc->show_usage_message = 1;
-				return;
-			}
-			cc->input_filename = argv[i];
-			de_set_input_filename(c, cc->input_filename);
+			add_input_filename(cc, argv[i]);
 		}
 	}
 
 	if(help_flag) {
-		if(module_flag || cc->input_filename || cc->from_stdin) {
+		if(module_flag || cc->num_inputs>0 || cc->from_stdin) {
+			if(cc->num_inputs>0) {
+				cc->input_filename = cc->inputs[0];
+				de_set_input_filename(c, cc->input_filename);
+			}
 			de_set_want_modhelp(c, 1);
 		}
 		else {
@@ -878,7 +992,14 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 		return;
 	}
 
-	if(!cc->input_filename && !cc->special_command_flag && !cc->from_stdin) {
+	if(cc->special_command_flag) {
+		return;
+	}
+
+	setup_batch_mode(c, cc);
+	if(cc->error_flag) return;
+
+	if(!cc->input_filename && !cc->batch_mode && !cc->from_stdin) {
 		de_puts(c, DE_MSGTYPE_MESSAGE, "Error: Need an input filename\n");
 		cc->error_flag = 1;
 		cc->show_usage_message = 1;
@@ -897,10 +1018,98 @@ static void parse_cmdline(deark *c, struct cmdctx *cc, int argc, char **argv)
 		}
 	}
 
-	set_output_basename(cc);
+	if(!cc->batch_mode) {
+		set_output_basename(cc);
+	}
 	set_output_archive_name(cc);
 }
 
+// Process input file #cc->input_idx.
+static int run_one_batch_input(struct cmdctx *cc)
+{
+	deark *c = cc->c;
+
+	cc->input_filename = cc->inputs[cc->input_idx];
+	de_set_input_filename(c, cc->input_filename);
+	set_output_basename(cc);
+	if(!cc->noinfo) {
+		de_printf(c, DE_MSGTYPE_MESSAGE, "Input file %d/%d: %s\n",
+			cc->input_idx+1, cc->num_inputs, cc->input_filename);
+	}
+	return de_run(c);
+}
+
+// Runs in a worker process.
+static int batch_worker_fn(void *userdata)
+{
+	struct cmdctx *cc = (struct cmdctx*)userdata;
+	int ret;
+
+	ret = run_one_batch_input(cc);
+	// Flush and close the files that this process has written to.
+	de_destroy(cc->c);
+	return ret ? 0 : 1;
+}
+
+// Each input file is processed by a separate worker process (which gets
+// its own copy of the deark object), with up to cc->num_jobs running at once.
+// Output filenames are already unique to each input file, so the workers
+// don't need to coordinate.
+static int run_batch_parallel(struct cmdctx *cc)
+{
+	int num_running = 0;
+	int retval = 1;
+
+	cc->input_idx = 0;
+	while(cc->input_idx<cc->num_inputs || num_running>0) {
+		int exit_status = 0;
+
+		if(cc->input_idx<cc->num_inputs && num_running<cc->num_jobs) {
+			if(de_start_worker_process(batch_worker_fn, (void*)cc) >= 0) {
+				num_running++;
+			}
+			else {
+				// Couldn't start a worker, so do it ourselves.
+				if(!run_one_batch_input(cc)) retval = 0;
+			}
+			cc->input_idx++;
+			continue;
+		}
+
+		if(de_wait_for_worker_process(&exit_status) < 0) break;
+		num_running--;
+		if(exit_status!=0) retval = 0;
+	}
+
+	return retval;
+}
+
+static int run_batch(struct cmdctx *cc)
+{
+	int retval = 1;
+
+	if(cc->num_jobs>1 && (cc->to_zip || cc->to_tar)) {
+		// All the output would have to go through a single archive writer.
+		de_puts(cc->c, DE_MSGTYPE_MESSAGE, "Warning: -j is not supported with "
+			"-zip/-tar, and will be ignored\n");
+		cc->num_jobs = 1;
+	}
+
+	de_prepare_batch(cc->c);
+
+	if(cc->num_jobs>1) {
+		return run_batch_parallel(cc);
+	}
+
+	for(cc->input_idx=0; cc->input_idx<cc->num_inputs; cc->input_idx++) {
+		if(!run_one_batch_input(cc)) {
+			retval = 0;
+		}
+	}
+
+	return retval;
+}
+
 static int main2(int argc, char **argv)
 {
 	deark *c = NULL;
@@ -961,12 +1170,16 @@ static int main2(int argc, char **argv)
 	}
 #endif
 
-	ret = de_run(c);
+	if(cc->batch_mode)
+		ret = run_batch(cc);
+	else
+		ret = de_run(c);
 	if(!ret) {
 		exit_status = 1;
 	}
 
 done:
+	free_input_filenames(cc);
 	de_destroy(c);
 	de_platformdata_destroy(cc->plctx);
 	cc->plctx = NULL;
@@ -12,11 +12,203 @@
 
 #define DE_DUMMY_MAX_FILE_SIZE (1LL<<56)
 #define DE_MAX_MEMBUF_SIZE 2000000000
+// ZIP member files larger than this are not held in memory; see
+// de_zip_start_streaming_member().
+#define DE_ZIP_STREAMING_THRESHOLD (1024*1024)
 #define DE_CACHE_SIZE 262144
 
+#if defined(DE_WINDOWS) || defined(DE_UNIX)
+#define DE_USE_MMAP
+#endif
+
+// On 32-bit systems, don't use up the address space by mapping huge files.
+#define DE_MAX_MMAP_SIZE_32BIT 0x20000000LL
+
+#ifdef DE_USE_MMAP
+// Try to make the cache a memory-mapped view of the entire file.
+// Returns 0 if that's not possible.
+static int populate_cache_mmap(dbuf *f)
+{
+	deark *c = f->c;
+	const u8 *mem;
+	void *handle = NULL;
+
+	if(sizeof(void*)<8 && f->len>DE_MAX_MMAP_SIZE_32BIT) return 0;
+	if(!de_get_ext_option_bool(c, "mmap", 1)) return 0;
+
+	mem = de_mmap_for_read(c, f->fp, f->len, &handle);
+	if(!mem) return 0;
+
+	de_dbg3(c, "memory-mapped %"I64_FMT" bytes", f->len);
+	// The cache is never written to, so it's okay to cast away the const.
+	f->cache = (u8*)mem;
+	f->cache_is_mmap = 1;
+	f->mmap_handle = handle;
+	f->cache_start_pos = 0;
+	f->cache_bytes_used = f->len;
+	return 1;
+}
+#endif
+
+#define DE_BLOCKCACHE_BLOCKSIZE 65536
+#define DE_BLOCKCACHE_DEFAULT_NBLOCKS 16
+#define DE_BLOCKCACHE_MAX_NBLOCKS 4096
+
+struct dbuf_cacheblock {
+	i64 start_pos;
+	i64 bytes_used; // 0 = this block is not in use
+	u64 last_used;
+	u8 *data;
+};
+
+// An N-way cache of fixed-size blocks, with LRU replacement.
+// Used for regular input files, when we can't memory-map the whole file.
+struct dbuf_blockcache {
+	i64 num_blocks;
+	u64 use_counter;
+	i64 hits;
+	i64 misses;
+	struct dbuf_cacheblock *mru; // The most recently used block, or NULL
+	struct dbuf_cacheblock *blocks; // array[num_blocks]
+};
+
+static void blockcache_create(dbuf *f)
+{
+	deark *c = f->c;
+	i64 num_blocks;
+	const char *s;
+
+	num_blocks = DE_BLOCKCACHE_DEFAULT_NBLOCKS;
+	s = de_get_ext_option(c, "readcache");
+	if(s) {
+		num_blocks = de_atoi64(s);
+		if(num_blocks>DE_BLOCKCACHE_MAX_NBLOCKS) num_blocks = DE_BLOCKCACHE_MAX_NBLOCKS;
+	}
+	if(num_blocks<1) return;
+	// Don't bother, if all the data fits in the head cache.
+	if(f->len <= DE_CACHE_SIZE) return;
+
+	f->bcache = de_malloc(c, sizeof(struct dbuf_blockcache));
+	f->bcache->num_blocks = num_blocks;
+	f->bcache->blocks = de_mallocarray(c, num_blocks, sizeof(struct dbuf_cacheblock));
+}
+
+static void blockcache_destroy(dbuf *f)
+{
+	deark *c = f->c;
+	struct dbuf_blockcache *bc = f->bcache;
+	i64 i;
+
+	if(!bc) return;
+	de_dbg2(c, "read cache: %"I64_FMT" hits, %"I64_FMT" misses", bc->hits, bc->misses);
+	for(i=0; i<bc->num_blocks; i++) {
+		de_free(c, bc->blocks[i].data);
+	}
+	de_free(c, bc->blocks);
+	de_free(c, bc);
+	f->bcache = NULL;
+}
+
+static void fread_at(dbuf *f, u8 *buf, i64 pos, i64 len, i64 *pbytes_read)
+{
+	// For performance reasons, don't call fseek if we're already at the
+	// right position.
+	if(!f->file_pos_known || f->file_pos!=pos) {
+		de_fseek(f->fp, pos, SEEK_SET);
+	}
+
+	*pbytes_read = (i64)fread(buf, 1, (size_t)len, f->fp);
+
+	f->file_pos = pos + *pbytes_read;
+	f->file_pos_known = 1;
+}
+
+// Returns the block that contains file position pos, reading it from the
+// file if necessary.
+// pos must be a valid position in the file.
+static struct dbuf_cacheblock *blockcache_get_block(dbuf *f, i64 pos)
+{
+	struct dbuf_blockcache *bc = f->bcache;
+	struct dbuf_cacheblock *blk = NULL;
+	i64 block_start;
+	i64 i;
+
+	block_start = pos - (pos % DE_BLOCKCACHE_BLOCKSIZE);
+	bc->use_counter++;
+
+	if(bc->mru && bc->mru->start_pos==block_start) {
+		blk = bc->mru;
+		goto hit;
+	}
+
+	for(i=0; i<bc->num_blocks; i++) {
+		if(bc->blocks[i].bytes_used>0 && bc->blocks[i].start_pos==block_start) {
+			blk = &bc->blocks[i];
+			goto hit;
+		}
+	}
+
+	// Not found. Pick a block to replace: an unused one if possible, otherwise
+	// the least recently used one.
+	bc->misses++;
+	blk = &bc->blocks[0];
+	for(i=0; i<bc->num_blocks; i++) {
+		if(bc->blocks[i].bytes_used==0) {
+			blk = &bc->blocks[i];
+			break;
+		}
+		if(bc->blocks[i].last_used < blk->last_used) {
+			blk = &bc->blocks[i];
+		}
+	}
+
+	if(!blk->data) {
+		blk->data = de_malloc(f->c, DE_BLOCKCACHE_BLOCKSIZE);
+	}
+	blk->start_pos = block_start;
+	fread_at(f, blk->data, block_start,
+		de_min_int(DE_BLOCKCACHE_BLOCKSIZE, f->len - block_start), &blk->bytes_used);
+	if(blk->bytes_used<1) {
+		// Shouldn't happen, unless the file got shorter.
+		blk->bytes_used = 0;
+		bc->mru = NULL;
+		return NULL;
+	}
+	goto done;
+
+hit:
+	bc->hits++;
+done:
+	blk->last_used = bc->use_counter;
+	bc->mru = blk;
+	return blk;
+}
+
+// Read from the file via the block cache.
+// The caller must ensure that the range [pos, pos+len) is within the file.
+static void blockcache_read(dbuf *f, u8 *buf, i64 pos, i64 len, i64 *pbytes_read)
+{
+	struct dbuf_cacheblock *blk;
+	i64 n;
+
+	*pbytes_read = 0;
+	while(len>0) {
+		blk = blockcache_get_block(f, pos);
+		if(!blk) return;
+		if(pos >= blk->start_pos + blk->bytes_used) return;
+		n = blk->start_pos + blk->bytes_used - pos;
+		if(n>len) n = len;
+		de_memcpy(buf, &blk->data[pos - blk->start_pos], (size_t)n);
+		buf += n;
+		pos += n;
+		len -= n;
+		*pbytes_read += n;
+	}
+}
+
 // Fill the cache that remembers the first part of the file.
-// TODO: We should probably use memory-mapped files instead when possible,
-// but this is simple and portable, and does most of what we need.
+// If possible, we memory-map the whole file, and use that as the cache.
+// Otherwise, we also set up the block cache, for data beyond the first part.
 static void populate_cache(dbuf *f)
 {
 	i64 bytes_to_read;
@@ -24,6 +216,12 @@ static void populate_cache(dbuf *f)
 
 	if(f->btype!=DBUF_TYPE_IFILE) return;
 
+#ifdef DE_USE_MMAP
+	if(populate_cache_mmap(f)) return;
+#endif
+
+	blockcache_create(f);
+
 	bytes_to_read = DE_CACHE_SIZE;
 	if(f->len < bytes_to_read) {
 		bytes_to_read = f->len;
@@ -91,6 +289,7 @@ void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len)
 	deark *c;
 
 	c = f->c;
+	f->num_bytes_read += len;
 
 	if(pos < 0) {
 		if((-pos) >= len) {
@@ -141,16 +340,14 @@ void dbuf_read(dbuf *f, u8 *buf, i64 pos, i64 len)
 			goto done_read;
 		}
 
-		// For performance reasons, don't call fseek if we're already at the
-		// right position.
-		if(!f->file_pos_known || f->file_pos!=pos) {
-			de_fseek(f->fp, pos, SEEK_SET);
+		// Large reads bypass the block cache, so they don't evict everything
+		// in it.
+		if(f->bcache && bytes_to_read <= DE_BLOCKCACHE_BLOCKSIZE) {
+			blockcache_read(f, buf, pos, bytes_to_read, &bytes_read);
+		}
+		else {
+			fread_at(f, buf, pos, bytes_to_read, &bytes_read);
 		}
-
-		bytes_read = fread(buf, 1, (size_t)bytes_to_read, f->fp);
-
-		f->file_pos = pos + bytes_read;
-		f->file_pos_known = 1;
 		break;
 
 	case DBUF_TYPE_IDBUF:
@@ -203,14 +400,31 @@ u8 dbuf_getbyte(dbuf *f, i64 pos)
 		// and it is necessary to handle read+write dbuf types specially,
 		// so that the 1-byte "cache2" feature isn't used.
 		if(pos>=0 && pos<f->len) {
+			f->num_bytes_read++;
 			return f->membuf_buf[pos];
 		}
 		break;
 	default:
+		if(f->cache && pos>=f->cache_start_pos &&
+			pos < f->cache_start_pos + f->cache_bytes_used)
+		{
+			f->num_bytes_read++;
+			return f->cache[pos - f->cache_start_pos];
+		}
+
 		if(f->cache2_bytes_used>0 && pos==f->cache2_start_pos) {
+			f->num_bytes_read++;
 			return f->cache2[0];
 		}
 
+		if(f->bcache && f->bcache->mru && pos>=f->bcache->mru->start_pos &&
+			pos < f->bcache->mru->start_pos + f->bcache->mru->bytes_used)
+		{
+			f->num_bytes_read++;
+			f->bcache->hits++;
+			return f->bcache->mru->data[pos - f->bcache->mru->start_pos];
+		}
+
 		dbuf_read(f, &f->cache2[0], pos, 1);
 		f->cache2_bytes_used = 1;
 		f->cache2_start_pos = pos;
@@ -921,6 +1135,7 @@ int dbuf_memcmp(dbuf *f, i64 pos, const void *s, size_t n)
 		pos + (i64)n <= f->cache_start_pos + f->cache_bytes_used)
 	{
 		// Fastest path: Compare directly to cache.
+		f->num_bytes_read += (i64)n;
 		return de_memcmp(s, &f->cache[pos - f->cache_start_pos], n);
 	}
 
@@ -959,6 +1174,8 @@ static void finfo_shallow_copy(deark *c, de_finfo *src, de_finfo *dst)
 	dst->has_hotspot = src->has_hotspot;
 	dst->hotspot_x = src->hotspot_x;
 	dst->hotspot_y = src->hotspot_y;
+	dst->len_known = src->len_known;
+	dst->len = src->len;
 }
 
 // Create or open a file for writing, that is *not* one of the usual
@@ -980,6 +1197,7 @@ dbuf *dbuf_create_unmanaged_file(deark *c, const char *fname, int overwrite_mode
 
 	f->btype = DBUF_TYPE_OFILE;
 	f->max_len_hard = c->max_output_file_size;
+	f->write_combining = 1;
 	f->fp = de_fopen_for_write(c, f->name, msgbuf, sizeof(msgbuf),
 		c->overwrite_mode, flags);
 
@@ -1002,6 +1220,7 @@ dbuf *dbuf_create_unmanaged_file_stdout(deark *c, const char *name)
 	f->name = de_strdup(c, name);
 	f->btype = DBUF_TYPE_STDOUT;
 	f->max_len_hard = c->max_output_file_size;
+	f->write_combining = 1;
 	f->fp = stdout;
 	return f;
 }
@@ -1027,11 +1246,93 @@ static void sanitize_ext(const char *ext1, char *ext, size_t extlen)
 	}
 }
 
+// Decide where the data for the managed output file f will go (e.g. to a
+// file, or to a ZIP archive), and prepare to write it there.
+static void open_output_file_dest(deark *c, dbuf *f, u8 is_directory)
+{
+	char msgbuf[200];
+
+	if(c->extrlist_dbuf) {
+		dbuf_printf(c->extrlist_dbuf, "%s\n", f->name);
+		dbuf_flush(c->extrlist_dbuf);
+	}
+
+	if(c->list_mode) {
+		char idbuf[32];
+		char sizebuf[32];
+
+		f->btype = DBUF_TYPE_NULL;
+		idbuf[0] = '\0';
+		sizebuf[0] = '\0';
+		if(c->list_mode_include_file_id) {
+			de_snprintf(idbuf, sizeof(idbuf), "%d:", f->output_file_index);
+		}
+		if(c->list_mode_include_size) {
+			if(is_directory) {
+				de_strlcpy(sizebuf, "-\t", sizeof(sizebuf));
+			}
+			else if(f->fi_copy && f->fi_copy->len_known) {
+				de_snprintf(sizebuf, sizeof(sizebuf), "%"I64_FMT"\t", f->fi_copy->len);
+			}
+			else {
+				de_strlcpy(sizebuf, "?\t", sizeof(sizebuf));
+			}
+		}
+		de_msg(c, "%s%s%s", idbuf, sizebuf, f->name);
+		return;
+	}
+
+	if(c->output_style==DE_OUTPUTSTYLE_ARCHIVE && c->archive_fmt==DE_ARCHIVEFMT_TAR) {
+		de_info(c, "Adding %s to TAR file", f->name);
+		f->btype = DBUF_TYPE_ODBUF;
+		// A dummy max_len_hard value. The parent will do the checking.
+		f->max_len_hard = DE_DUMMY_MAX_FILE_SIZE;
+		f->writing_to_tar_archive = 1;
+		de_tar_start_member_file(c, f);
+	}
+	else if(c->output_style==DE_OUTPUTSTYLE_ARCHIVE) { // ZIP
+		i64 initial_alloc;
+		de_info(c, "Adding %s to ZIP file", f->name);
+		f->btype = DBUF_TYPE_MEMBUF;
+		f->max_len_hard = DE_MAX_MEMBUF_SIZE;
+		if(is_directory) {
+			// A directory entry is not expected to have any data associated
+			// with it (besides the files it contains).
+			initial_alloc = 16;
+		}
+		else {
+			initial_alloc = 65536;
+		}
+		f->membuf_buf = de_malloc(c, initial_alloc);
+		f->membuf_alloc = initial_alloc;
+		f->write_memfile_to_zip_archive = 1;
+	}
+	else if(c->output_style==DE_OUTPUTSTYLE_STDOUT) {
+		de_info(c, "Writing %s to [stdout]", f->name);
+		f->btype = DBUF_TYPE_STDOUT;
+		// TODO: Should we increase f->max_len_hard?
+		f->write_combining = 1;
+		f->fp = stdout;
+	}
+	else {
+		de_info(c, "Writing %s", f->name);
+		f->btype = DBUF_TYPE_OFILE;
+		f->write_combining = 1;
+		f->fp = de_fopen_for_write(c, f->name, msgbuf, sizeof(msgbuf),
+			c->overwrite_mode, 0);
+
+		if(!f->fp) {
+			de_err(c, "Failed to write %s: %s", f->name, msgbuf);
+			f->btype = DBUF_TYPE_NULL;
+			c->serious_error_flag = 1;
+		}
+	}
+}
+
 dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 	unsigned int createflags)
 {
 	char nbuf[500];
-	char msgbuf[200];
 	char ext[128];
 	int have_ext;
 	dbuf *f;
@@ -1175,72 +1476,55 @@ dbuf *dbuf_create_output_file(deark *c, const char *ext1, de_finfo *fi,
 	}
 
 	c->num_files_extracted++;
-
-	if(c->extrlist_dbuf) {
-		dbuf_printf(c->extrlist_dbuf, "%s\n", f->name);
-		dbuf_flush(c->extrlist_dbuf);
-	}
-
-	if(c->list_mode) {
-		f->btype = DBUF_TYPE_NULL;
-		if(c->list_mode_include_file_id) {
-			de_msg(c, "%d:%s", file_index, f->name);
-		}
-		else {
-			de_msg(c, "%s", f->name);
-		}
-		goto done;
+	if(!(createflags&DE_CREATEFLAG_IS_AUX)) {
+		c->num_main_files_created++;
 	}
+	f->output_file_index = file_index;
 
-	if(c->output_style==DE_OUTPUTSTYLE_ARCHIVE && c->archive_fmt==DE_ARCHIVEFMT_TAR) {
-		de_info(c, "Adding %s to TAR file", f->name);
-		f->btype = DBUF_TYPE_ODBUF;
-		// A dummy max_len_hard value. The parent will do the checking.
-		f->max_len_hard = DE_DUMMY_MAX_FILE_SIZE;
-		f->writing_to_tar_archive = 1;
-		de_tar_start_member_file(c, f);
-	}
-	else if(c->output_style==DE_OUTPUTSTYLE_ARCHIVE) { // ZIP
-		i64 initial_alloc;
-		de_info(c, "Adding %s to ZIP file", f->name);
+	if(c->recurse_depth < c->recurse_max_depth && c->recurse_budget>0 &&
+		c->output_style!=DE_OUTPUTSTYLE_STDOUT &&
+		!is_directory && !(createflags&DE_CREATEFLAG_NO_RECURSE))
+	{
+		// Hold the file in memory until it is complete, so we can look inside
+		// it. It will be written out (or not) when it is closed.
 		f->btype = DBUF_TYPE_MEMBUF;
-		f->max_len_hard = DE_MAX_MEMBUF_SIZE;
-		if(is_directory) {
-			// A directory entry is not expected to have any data associated
-			// with it (besides the files it contains).
-			initial_alloc = 16;
-		}
-		else {
-			initial_alloc = 65536;
-		}
-		f->membuf_buf = de_malloc(c, initial_alloc);
-		f->membuf_alloc = initial_alloc;
-		f->write_memfile_to_zip_archive = 1;
-	}
-	else if(c->output_style==DE_OUTPUTSTYLE_STDOUT) {
-		de_info(c, "Writing %s to [stdout]", f->name);
-		f->btype = DBUF_TYPE_STDOUT;
-		// TODO: Should we increase f->max_len_hard?
-		f->fp = stdout;
+		f->recurse_pending = 1;
+		goto done;
 	}
-	else {
-		de_info(c, "Writing %s", f->name);
-		f->btype = DBUF_TYPE_OFILE;
-		f->fp = de_fopen_for_write(c, f->name, msgbuf, sizeof(msgbuf),
-			c->overwrite_mode, 0);
 
-		if(!f->fp) {
-			de_err(c, "Failed to write %s: %s", f->name, msgbuf);
-			f->btype = DBUF_TYPE_NULL;
-			c->serious_error_flag = 1;
-		}
-	}
+	open_output_file_dest(c, f, is_directory);
 
 done:
 	de_free(c, name_from_finfo);
 	return f;
 }
 
+// For an output file that is being held in memory in recursive mode:
+// Start writing it to its real destination, starting with the data that we
+// already have.
+static void release_recurse_pending_file(dbuf *f)
+{
+	deark *c = f->c;
+	u8 *mem;
+	i64 memlen;
+	de_writelistener_cb_type saved_cb;
+
+	mem = f->membuf_buf;
+	memlen = f->len;
+	f->recurse_pending = 0;
+	f->membuf_buf = NULL;
+	f->membuf_alloc = 0;
+	f->len = 0;
+	open_output_file_dest(c, f, 0);
+
+	// The write listener (if any) has already seen this data.
+	saved_cb = f->writelistener_cb;
+	f->writelistener_cb = NULL;
+	dbuf_write(f, mem, memlen);
+	f->writelistener_cb = saved_cb;
+	de_free(c, mem);
+}
+
 static void do_on_dbuf_size_exceeded(dbuf *f)
 {
 	de_err(f->c, "Maximum %s size of %"I64_FMT" bytes exceeded",
@@ -1302,15 +1586,75 @@ static void membuf_append(dbuf *f, const u8 *m, i64 mlen)
 	f->len += mlen;
 }
 
+// Size of the write-combining buffer
+#define DBUF_WCBUF_SIZE 8192
+// Writes smaller than this are candidates for write-combining.
+#define DBUF_WC_MAX_WRITE 256
+
+static void dbuf_write_direct(dbuf *f, const u8 *m, i64 len);
+
+// Pass any data in the write-combining buffer on to its destination.
+static void dbuf_flush_wcbuf(dbuf *f)
+{
+	i64 n;
+	de_writelistener_cb_type saved_cb;
+
+	if(f->wcbuf_used<1) return;
+	n = f->wcbuf_used;
+	f->wcbuf_used = 0;
+	f->len -= n; // dbuf_write_direct() will add it back
+
+	// The write listener (if any) has already seen this data.
+	saved_cb = f->writelistener_cb;
+	f->writelistener_cb = NULL;
+	dbuf_write_direct(f, f->wcbuf, n);
+	f->writelistener_cb = saved_cb;
+}
+
 void dbuf_write(dbuf *f, const u8 *m, i64 len)
 {
+	if(f->write_combining && len<DBUF_WC_MAX_WRITE && f->len + len <= f->max_len_hard) {
+		if(!f->wcbuf) {
+			f->wcbuf = de_malloc(f->c, DBUF_WCBUF_SIZE);
+		}
+		if(f->wcbuf_used + len > DBUF_WCBUF_SIZE) {
+			dbuf_flush_wcbuf(f);
+		}
+		// The listener sees the data now, not when it leaves wcbuf, so that
+		// whatever it computes is always up to date.
+		if(f->writelistener_cb) {
+			f->writelistener_cb(f, f->userdata_for_writelistener, m, len);
+		}
+		de_memcpy(&f->wcbuf[f->wcbuf_used], m, (size_t)len);
+		f->wcbuf_used += len;
+		f->len += len;
+		return;
+	}
+
+	dbuf_flush_wcbuf(f);
+	dbuf_write_direct(f, m, len);
+}
+
+static void dbuf_write_direct(dbuf *f, const u8 *m, i64 len)
+{
+	if(f->recurse_pending &&
+		(f->len + len > f->c->recurse_budget || f->len + len > DE_MAX_MEMBUF_SIZE))
+	{
+		// Too big to look inside. Write it out normally.
+		release_recurse_pending_file(f);
+	}
+
+	if(f->write_memfile_to_zip_archive && f->btype==DBUF_TYPE_MEMBUF &&
+		f->len + len > DE_ZIP_STREAMING_THRESHOLD)
+	{
+		de_zip_start_streaming_member(f->c, f);
+	}
+
 	if(f->len + len > f->max_len_hard) {
 		do_on_dbuf_size_exceeded(f);
 	}
 
 	if(f->writelistener_cb) {
-		// Note that the callback function can be changed at any time, so if we
-		// ever decide to buffer these calls, precautions will be needed.
 		f->writelistener_cb(f, f->userdata_for_writelistener, m, len);
 	}
 
@@ -1351,15 +1695,32 @@ void dbuf_write(dbuf *f, const u8 *m, i64 len)
 
 void dbuf_writebyte(dbuf *f, u8 n)
 {
+	// Fast paths for the most common cases
+	if(f->wcbuf && f->wcbuf_used<DBUF_WCBUF_SIZE && f->len < f->max_len_hard &&
+		!f->writelistener_cb)
+	{
+		f->wcbuf[f->wcbuf_used++] = n;
+		f->len++;
+		return;
+	}
+	if(f->btype==DBUF_TYPE_MEMBUF && f->len < f->membuf_alloc &&
+		!f->writelistener_cb && !f->recurse_pending && !f->has_len_limit &&
+		!f->write_memfile_to_zip_archive && f->len < f->max_len_hard)
+	{
+		f->membuf_buf[f->len++] = n;
+		return;
+	}
+
 	dbuf_write(f, &n, 1);
 }
 
 // Allowed only for membufs, and unmanaged output files.
-// For unmanaged output files, must be used with care, and should not be
-// mixed with dbuf_write().
+// For unmanaged output files, must be used with care. If it is mixed with
+// dbuf_write(), it should only be used to overwrite existing data.
 void dbuf_write_at(dbuf *f, i64 pos, const u8 *m, i64 len)
 {
 	if(len<1 || pos<0) return;
+	dbuf_flush_wcbuf(f);
 
 	if(pos + len > f->max_len_hard) {
 		do_on_dbuf_size_exceeded(f);
@@ -1404,6 +1765,10 @@ void dbuf_write_at(dbuf *f, i64 pos, const u8 *m, i64 len)
 		if(pos+len > f->len) {
 			f->len = pos+len;
 		}
+		else if(pos+len < f->len) {
+			// Go back to the end, where dbuf_write() expects to be.
+			de_fseek(f->fp, f->len, SEEK_SET);
+		}
 	}
 	else if(f->btype==DBUF_TYPE_NULL) {
 		if(pos+len > f->len) {
@@ -1592,11 +1957,24 @@ void dbuf_printf(dbuf *f, const char *fmt, ...)
 
 void dbuf_flush(dbuf *f)
 {
-	if(f->btype==DBUF_TYPE_OFILE) {
+	dbuf_flush_wcbuf(f);
+	if((f->btype==DBUF_TYPE_OFILE || f->btype==DBUF_TYPE_STDOUT) && f->fp) {
 		fflush(f->fp);
 	}
 }
 
+// Returns nonzero if anything written to f will simply be thrown away, e.g.
+// because f is an output file that is not selected by -firstfile/-maxfiles,
+// or we are in -l mode. A module may use this to avoid doing the work of
+// decompressing a file that nobody will see. (If it does, it must also skip
+// any integrity checks that rely on the data passing through a write
+// listener.)
+int dbuf_is_discarded(dbuf *f)
+{
+	if(!f) return 1;
+	return (f->btype==DBUF_TYPE_NULL);
+}
+
 dbuf *dbuf_open_input_file(deark *c, const char *fn)
 {
 	dbuf *f;
@@ -1686,6 +2064,18 @@ void dbuf_close(dbuf *f)
 	if(!f) return;
 	c = f->c;
 
+	dbuf_flush_wcbuf(f);
+
+	if(f->recurse_pending) {
+		if(de_recurse_into_output_file(c, f)) {
+			release_recurse_pending_file(f);
+		}
+		else {
+			de_dbg(c, "not keeping %s", f->name);
+		}
+		f->recurse_pending = 0;
+	}
+
 	if(f->btype==DBUF_TYPE_OFILE || f->btype==DBUF_TYPE_STDOUT) {
 		c->total_output_size += f->len;
 	}
@@ -1696,6 +2086,9 @@ void dbuf_close(dbuf *f)
 			de_dbg3(c, "closing memfile %s", f->name);
 		}
 	}
+	else if(f->writing_to_zip_stream) {
+		de_zip_end_streaming_member(c, f);
+	}
 	else if(f->writing_to_tar_archive) {
 		de_tar_end_member_file(c, f);
 	}
@@ -1738,8 +2131,15 @@ void dbuf_close(dbuf *f)
 	}
 
 	de_free(c, f->membuf_buf);
+	de_free(c, f->wcbuf);
 	de_free(c, f->name);
-	de_free(c, f->cache);
+	blockcache_destroy(f);
+	if(f->cache_is_mmap) {
+		de_munmap(c, f->cache, f->len, f->mmap_handle);
+	}
+	else {
+		de_free(c, f->cache);
+	}
 	if(f->fi_copy) de_finfo_destroy(c, f->fi_copy);
 	de_free(c, f);
 
@@ -1760,6 +2160,139 @@ void dbuf_empty(dbuf *f)
 	}
 }
 
+// If the bytes [pos, pos+len) of f are all already in memory, returns a
+// pointer to them. Otherwise returns NULL.
+static const u8 *dbuf_get_mem_ptr(dbuf *f, i64 pos, i64 len)
+{
+	if(pos<0 || len<0 || pos+len > f->len) return NULL;
+
+	switch(f->btype) {
+	case DBUF_TYPE_MEMBUF:
+		return &f->membuf_buf[pos];
+	case DBUF_TYPE_IDBUF:
+		return dbuf_get_mem_ptr(f->parent_dbuf, f->offset_into_parent_dbuf+pos, len);
+	default:
+		break;
+	}
+
+	if(!f->cache && f->cache_policy==DE_CACHE_POLICY_ENABLED) {
+		populate_cache(f);
+	}
+	if(f->cache && pos>=f->cache_start_pos &&
+		pos+len <= f->cache_start_pos+f->cache_bytes_used)
+	{
+		return &f->cache[pos-f->cache_start_pos];
+	}
+	return NULL;
+}
+
+// Find the first occurrence of needle in a memory buffer.
+// Returns the offset, or -1 if not found.
+// needle_len must be at least 1.
+static i64 mem_search(const u8 *hay, i64 hay_len, const u8 *needle, i64 needle_len)
+{
+	const u8 *p;
+	const u8 *endp; // Last position at which the needle could start
+	i64 i;
+	i64 skip[256];
+
+	if(needle_len > hay_len) return -1;
+	endp = hay + (hay_len - needle_len);
+
+	if(needle_len<4 || hay_len<256) {
+		// Use memchr to find candidates for the first byte. memchr is usually
+		// vectorized by the C library, so this is fast when that byte is rare.
+		p = hay;
+		while(p<=endp) {
+			p = (const u8*)de_memchr(p, needle[0], (size_t)(endp-p+1));
+			if(!p) return -1;
+			if(!de_memcmp(p, needle, (size_t)needle_len)) return (i64)(p-hay);
+			p++;
+		}
+		return -1;
+	}
+
+	// Boyer-Moore-Horspool, for longer needles.
+	for(i=0; i<256; i++) {
+		skip[i] = needle_len;
+	}
+	for(i=0; i<needle_len-1; i++) {
+		skip[needle[i]] = needle_len-1-i;
+	}
+
+	p = hay;
+	while(p<=endp) {
+		u8 lastbyte = p[needle_len-1];
+
+		if(lastbyte==needle[needle_len-1] && p[0]==needle[0] &&
+			!de_memcmp(p, needle, (size_t)needle_len))
+		{
+			return (i64)(p-hay);
+		}
+		p += skip[lastbyte];
+	}
+	return -1;
+}
+
+#define DE_SEARCH_CHUNK_SIZE 65536
+
+// Search [startpos, startpos+haystack_len), which must be within the file.
+// The data is read in chunks, with enough overlap between chunks that no
+// match is missed.
+static int dbuf_search_internal(dbuf *f, const u8 *needle, i64 needle_len,
+	i64 startpos, i64 haystack_len, i64 *foundpos)
+{
+	const u8 *mem;
+	u8 *buf = NULL;
+	i64 bufsize;
+	i64 pos; // File position corresponding to buf[0]
+	i64 ret;
+	int retval = 0;
+
+	mem = dbuf_get_mem_ptr(f, startpos, haystack_len);
+	if(mem) {
+		// Fast path: all the data is in memory.
+		ret = mem_search(mem, haystack_len, needle, needle_len);
+		if(ret>=0) {
+			f->num_bytes_read += ret+needle_len;
+			*foundpos = startpos + ret;
+			retval = 1;
+		}
+		else {
+			f->num_bytes_read += haystack_len;
+		}
+		goto done;
+	}
+
+	bufsize = DE_SEARCH_CHUNK_SIZE + needle_len - 1;
+	if(bufsize > haystack_len) bufsize = haystack_len;
+	buf = de_malloc(f->c, bufsize);
+
+	pos = startpos;
+	while(1) {
+		i64 nbytes;
+
+		nbytes = startpos + haystack_len - pos;
+		if(nbytes < needle_len) break;
+		if(nbytes > bufsize) nbytes = bufsize;
+
+		dbuf_read(f, buf, pos, nbytes);
+		ret = mem_search(buf, nbytes, needle, needle_len);
+		if(ret>=0) {
+			*foundpos = pos + ret;
+			retval = 1;
+			goto done;
+		}
+
+		// Keep the last needle_len-1 bytes, since a match could start there.
+		pos += nbytes - (needle_len - 1);
+	}
+
+done:
+	de_free(f->c, buf);
+	return retval;
+}
+
 // Search a section of a dbuf for a given byte.
 // 'haystack_len' is the number of bytes to search.
 // Returns 0 if not found.
@@ -1768,14 +2301,30 @@ void dbuf_empty(dbuf *f)
 int dbuf_search_byte(dbuf *f, const u8 b, i64 startpos,
 	i64 haystack_len, i64 *foundpos)
 {
-	i64 i;
+	i64 file_startpos, file_endpos;
+
+	if(haystack_len<1) return 0;
 
-	for(i=0; i<haystack_len; i++) {
-		if(b == dbuf_getbyte(f, startpos+i)) {
-			*foundpos = startpos+i;
+	// Bytes outside the file read as 0.
+	if(startpos<0 && b==0x00) {
+		*foundpos = startpos;
+		return 1;
+	}
+
+	file_startpos = de_max_int(startpos, 0);
+	file_endpos = de_min_int(startpos+haystack_len, f->len);
+	if(file_endpos > file_startpos) {
+		if(dbuf_search_internal(f, &b, 1, file_startpos, file_endpos-file_startpos,
+			foundpos))
+		{
 			return 1;
 		}
 	}
+
+	if(b==0x00 && startpos+haystack_len > f->len) {
+		*foundpos = de_max_int(startpos, f->len);
+		return 1;
+	}
 	return 0;
 }
 
@@ -1788,44 +2337,24 @@ int dbuf_search_byte(dbuf *f, const u8 b, i64 startpos,
 int dbuf_search(dbuf *f, const u8 *needle, i64 needle_len,
 	i64 startpos, i64 haystack_len, i64 *foundpos)
 {
-	u8 *buf = NULL;
-	int retval = 0;
-	i64 i;
-
 	*foundpos = 0;
 
 	if(startpos > f->len) {
-		goto done;
+		return 0;
 	}
 	if(haystack_len > f->len - startpos) {
 		haystack_len = f->len - startpos;
 	}
 	if(needle_len > haystack_len) {
-		goto done;
+		return 0;
 	}
 	if(needle_len<1) {
-		retval = 1;
 		*foundpos = startpos;
-		goto done;
+		return 1;
 	}
 
-	// TODO: Read memory in chunks (to support large files, and to be more efficient).
-	// Don't read it all at once.
-
-	buf = de_malloc(f->c, haystack_len);
-	dbuf_read(f, buf, startpos, haystack_len);
-
-	for(i=0; i<=haystack_len-needle_len; i++) {
-		if(needle[0]==buf[i] && !de_memcmp(needle, &buf[i], (size_t)needle_len)) {
-			retval = 1;
-			*foundpos = startpos+i;
-			goto done;
-		}
-	}
-
-done:
-	de_free(f->c, buf);
-	return retval;
+	return dbuf_search_internal(f, needle, needle_len, startpos, haystack_len,
+		foundpos);
 }
 
 // Search for the aligned pair of 0x00 bytes that marks the end of a UTF-16 string.
@@ -2051,9 +2580,11 @@ done:
 	return retval;
 }
 
-// Optimized version, just for type membuf
-static int buffered_read_for_membuf(struct de_bufferedreadctx *brctx,
-	dbuf *f, i64 pos1, i64 len, de_buffered_read_cbfn cbfn)
+// Optimized version, for when all the data is already in memory
+// (membuf, or cached file).
+// 'mem' points to the first byte to read.
+static int buffered_read_from_mem(struct de_bufferedreadctx *brctx,
+	const u8 *mem, i64 len, de_buffered_read_cbfn cbfn)
 {
 	int retval = 0;
 	i64 total_nbytes_consumed = 0;
@@ -2068,8 +2599,7 @@ static int buffered_read_for_membuf(struct de_bufferedreadctx *brctx,
 		brctx->offset = total_nbytes_consumed;
 		brctx->eof_flag = 1;
 
-		ret = cbfn(brctx, &f->membuf_buf[pos1+total_nbytes_consumed],
-			nbytes_to_send);
+		ret = cbfn(brctx, &mem[total_nbytes_consumed], nbytes_to_send);
 		if(!ret) goto done;
 		if(brctx->bytes_consumed<1 || brctx->bytes_consumed>nbytes_to_send) {
 			goto done;
@@ -2089,11 +2619,24 @@ int dbuf_buffered_read(dbuf *f, i64 pos1, i64 len,
 	brctx.c = f->c;
 	brctx.userdata = userdata;
 
+	// Use an optimized routine if all the data we need to read is already
+	// in memory.
 	if(f->btype==DBUF_TYPE_MEMBUF && (pos1>=0) && (pos1+len<=f->len)) {
-		// Use an optimized routine if all the data we need to read is already
-		// in memory.
-		return buffered_read_for_membuf(&brctx, f, pos1, len, cbfn);
+		f->num_bytes_read += len;
+		return buffered_read_from_mem(&brctx, &f->membuf_buf[pos1], len, cbfn);
+	}
+
+	if(!f->cache && f->cache_policy==DE_CACHE_POLICY_ENABLED) {
+		populate_cache(f);
 	}
+	if(f->cache && pos1>=f->cache_start_pos &&
+		pos1+len <= f->cache_start_pos+f->cache_bytes_used)
+	{
+		f->num_bytes_read += len;
+		return buffered_read_from_mem(&brctx, &f->cache[pos1-f->cache_start_pos],
+			len, cbfn);
+	}
+
 	return buffered_read_internal(&brctx, f, pos1, len, cbfn);
 }
 
@@ -385,6 +385,8 @@ const char *de_fmtutil_get_windows_charset_name(u8 cs);
 const char *de_fmtutil_get_windows_cb_data_type_name(unsigned int ty);
 
 int de_fmtutil_find_zip_eocd(deark *c, dbuf *f, i64 *foundpos);
+int de_fmtutil_detect_jpeg_len(deark *c, dbuf *f, i64 pos1, i64 len,
+	i64 *pjpeglen, u8 *pis_jpegls);
 
 struct de_id3info {
 	int has_id3v1, has_id3v2;
@@ -411,6 +413,9 @@ struct de_advfile_forkinfo {
 	de_finfo *fi; // Note: do not set the name; use de_advfile.filename.
 	void *userdata_for_writelistener;
 	de_writelistener_cb_type writelistener_cb;
+	// Set by de_advfile_run() if the fork's data was not needed (see
+	// dbuf_is_discarded()), so the callback was not called for it.
+	u8 write_skipped;
 };
 
 struct de_advfile {
@@ -21,6 +21,8 @@ static void register_a_module(deark *c, de_module_getinfo_fn infofunc)
 static void disable_module(deark *c, struct deark_module_info *mi)
 {
 	mi->identify_fn = NULL;
+	mi->sigs = NULL;
+	mi->num_sigs = 0;
 	mi->run_fn = NULL;
 }
 
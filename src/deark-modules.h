@@ -235,12 +235,14 @@ DE_MODULE(de_module_d64)
 DE_MODULE(de_module_base64)
 DE_MODULE(de_module_base16)
 DE_MODULE(de_module_jpegscan)
+DE_MODULE(de_module_carve)
 DE_MODULE(de_module_ole1)
 DE_MODULE(de_module_olepropset)
 DE_MODULE(de_module_officeart)
 DE_MODULE(de_module_ddb)
 DE_MODULE(de_module_vgafont)
 DE_MODULE(de_module_crc)
+DE_MODULE(de_module_crctest)
 DE_MODULE(de_module_hexdump)
 DE_MODULE(de_module_bytefreq)
 DE_MODULE(de_module_cp437)
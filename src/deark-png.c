@@ -12,10 +12,13 @@
 // TODO: Finish removing the "mz" symbols, and other miniz things.
 #define MY_MZ_MIN(a,b) (((a)<(b))?(a):(b))
 #define MY_TDEFL_WRITE_ZLIB_HEADER  0x01000
+#define MY_TDEFL_GREEDY_PARSING_FLAG 0x04000
 
 #define CODE_IDAT 0x49444154U
 #define CODE_IEND 0x49454e44U
 #define CODE_IHDR 0x49484452U
+#define CODE_PLTE 0x504c5445U
+#define CODE_tRNS 0x74524e53U
 #define CODE_htSP 0x68745350U
 #define CODE_pHYs 0x70485973U
 #define CODE_tEXt 0x74455874U
@@ -27,7 +30,21 @@ struct deark_png_encode_info {
 	int width, height;
 	int num_chans;
 	int flip;
+	const u8 *src_pixels;
+	int bpl; // bytes per row in src_pixels
+	u8 color_type;
+	u8 bit_depth;
+	int num_threads;
+
+	// If the image is written as paletted (color type 3), src_pixels points
+	// to idx_pixels.
+	u8 *idx_pixels;
+	int num_pal_entries;
+	int num_trns_entries; // Number of palette entries that need a tRNS entry
+	u32 pal[256];
+
 	unsigned int level;
+	u8 fast; // Use the "fast" compression preset, instead of level
 	int has_phys;
 	u32 xdens;
 	u32 ydens;
@@ -67,16 +84,38 @@ static void write_png_chunk_from_cdbuf(struct deark_png_encode_info *pei,
 static void write_png_chunk_IHDR(struct deark_png_encode_info *pei,
 	dbuf *cdbuf)
 {
-	static const u8 color_type_code[] = {0x00, 0x00, 0x04, 0x02, 0x06};
-
 	dbuf_writeu32be(cdbuf, (i64)pei->width);
 	dbuf_writeu32be(cdbuf, (i64)pei->height);
-	dbuf_writebyte(cdbuf, 8); // bit depth
-	dbuf_writebyte(cdbuf, color_type_code[pei->num_chans]);
+	dbuf_writebyte(cdbuf, pei->bit_depth);
+	dbuf_writebyte(cdbuf, pei->color_type);
 	dbuf_truncate(cdbuf, 13); // rest of chunk is zeroes
 	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_IHDR);
 }
 
+static void write_png_chunk_PLTE(struct deark_png_encode_info *pei,
+	dbuf *cdbuf)
+{
+	int i;
+
+	for(i=0; i<pei->num_pal_entries; i++) {
+		dbuf_writebyte(cdbuf, DE_COLOR_R(pei->pal[i]));
+		dbuf_writebyte(cdbuf, DE_COLOR_G(pei->pal[i]));
+		dbuf_writebyte(cdbuf, DE_COLOR_B(pei->pal[i]));
+	}
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_PLTE);
+}
+
+static void write_png_chunk_tRNS(struct deark_png_encode_info *pei,
+	dbuf *cdbuf)
+{
+	int i;
+
+	for(i=0; i<pei->num_trns_entries; i++) {
+		dbuf_writebyte(cdbuf, DE_COLOR_A(pei->pal[i]));
+	}
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_tRNS);
+}
+
 static void write_png_chunk_pHYs(struct deark_png_encode_info *pei,
 	dbuf *cdbuf)
 {
@@ -128,25 +167,197 @@ static void write_png_chunk_tEXt(struct deark_png_encode_info *pei,
 	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_tEXt);
 }
 
-static int write_png_chunk_IDAT(struct deark_png_encode_info *pei, dbuf *cdbuf,
-	const u8 *src_pixels)
+#define PNG_NUM_FILTERS 5
+
+static u8 paeth_predictor(u8 a, u8 b, u8 c)
+{
+	int p, pa, pb, pc;
+
+	p = (int)a + (int)b - (int)c;
+	pa = p>(int)a ? p-(int)a : (int)a-p;
+	pb = p>(int)b ? p-(int)b : (int)b-p;
+	pc = p>(int)c ? p-(int)c : (int)c-p;
+	if(pa<=pb && pa<=pc) return a;
+	if(pb<=pc) return b;
+	return c;
+}
+
+// Apply PNG filter ftype to row cur, whose previous row is prev (all zeroes
+// for the first row). out[0] is set to the filter type, and the filtered
+// bytes are written to out[1...bpl].
+// These loops are kept simple, so that compilers can vectorize them.
+static void png_filter_row(int ftype, const u8 *cur, const u8 *prev, int bpl,
+	int bpp, u8 *out)
+{
+	int i;
+
+	out[0] = (u8)ftype;
+	out++;
+
+	switch(ftype) {
+	case 1: // Sub
+		for(i=0; i<bpp; i++) {
+			out[i] = cur[i];
+		}
+		for(i=bpp; i<bpl; i++) {
+			out[i] = (u8)(cur[i] - cur[i-bpp]);
+		}
+		break;
+	case 2: // Up
+		for(i=0; i<bpl; i++) {
+			out[i] = (u8)(cur[i] - prev[i]);
+		}
+		break;
+	case 3: // Average
+		for(i=0; i<bpp; i++) {
+			out[i] = (u8)(cur[i] - (prev[i]>>1));
+		}
+		for(i=bpp; i<bpl; i++) {
+			out[i] = (u8)(cur[i] - (u8)(((unsigned int)cur[i-bpp] + (unsigned int)prev[i])>>1));
+		}
+		break;
+	case 4: // Paeth
+		for(i=0; i<bpp; i++) {
+			out[i] = (u8)(cur[i] - prev[i]);
+		}
+		for(i=bpp; i<bpl; i++) {
+			out[i] = (u8)(cur[i] - paeth_predictor(cur[i-bpp], prev[i], prev[i-bpp]));
+		}
+		break;
+	default: // None
+		de_memcpy(out, cur, (size_t)bpl);
+		break;
+	}
+}
+
+// The "minimum sum of absolute differences" heuristic: treat each filtered
+// byte as a signed number, and add up their absolute values.
+static u32 png_filtered_row_cost(const u8 *row, int bpl)
+{
+	u32 sum = 0;
+	int i;
+
+	for(i=0; i<bpl; i++) {
+		sum += (row[i]<128) ? (u32)row[i] : (u32)(256-row[i]);
+	}
+	return sum;
+}
+
+static const unsigned int my_s_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+
+static int png_get_tdefl_flags(struct deark_png_encode_info *pei)
+{
+	if(pei->fast) {
+		// Like level 1, but with greedy parsing
+		return (int)(1 | MY_TDEFL_GREEDY_PARSING_FLAG);
+	}
+	return (int)my_s_tdefl_num_probes[MY_MZ_MIN(10, pei->level)];
+}
+
+// With the "fast" preset, the filter is chosen only once for each group of
+// this many rows.
+#define PNG_FAST_FILTER_ROWS 16
+
+// Working memory for filtering rows
+struct png_filter_ctx {
+	u8 *zerorow;
+	u8 *filtered[PNG_NUM_FILTERS];
+	int group_ftype; // Filter for the current group of rows, or -1
+};
+
+static void png_filter_ctx_init(deark *c, struct deark_png_encode_info *pei,
+	struct png_filter_ctx *fctx)
+{
+	int k;
+
+	fctx->zerorow = de_malloc(c, (i64)pei->bpl);
+	fctx->group_ftype = -1;
+	for(k=0; k<PNG_NUM_FILTERS; k++) {
+		fctx->filtered[k] = de_malloc(c, (i64)pei->bpl+1);
+	}
+}
+
+static void png_filter_ctx_free(deark *c, struct png_filter_ctx *fctx)
+{
+	int k;
+
+	de_free(c, fctx->zerorow);
+	for(k=0; k<PNG_NUM_FILTERS; k++) {
+		de_free(c, fctx->filtered[k]);
+	}
+}
+
+static const u8 *png_get_row(struct deark_png_encode_info *pei, int y)
+{
+	return &pei->src_pixels[(i64)(pei->flip ? (pei->height - 1 - y) : y) * pei->bpl];
+}
+
+// Filter row y, and return a pointer to the filtered row (bpl+1 bytes,
+// including the filter type byte). The pointer is valid until the next call.
+static const u8 *png_filter_row_auto(struct deark_png_encode_info *pei, int y,
+	struct png_filter_ctx *fctx)
+{
+	const u8 *cur;
+	const u8 *prev;
+	int bpl = pei->bpl;
+	int filter_bpp;
+	int best_ftype = 0;
+	int k;
+
+	// For filtering purposes, the number of bytes per complete pixel
+	filter_bpp = (pei->color_type==3 || pei->bit_depth<8) ? 1 : pei->num_chans;
+
+	cur = png_get_row(pei, y);
+	prev = (y>0) ? png_get_row(pei, y-1) : fctx->zerorow;
+
+	if(pei->level==0 || pei->color_type==3 || pei->bit_depth<8) {
+		// Not compressing, so filtering would be a waste of time.
+		// Or, paletted or less than 8 bits/pixel, for which filtering
+		// rarely helps.
+		png_filter_row(0, cur, prev, bpl, filter_bpp, fctx->filtered[0]);
+	}
+	else if(pei->fast && fctx->group_ftype>=0 && (y%PNG_FAST_FILTER_ROWS)!=0) {
+		// Trying every filter on every row costs about as much as the fast
+		// compressor does, so reuse the filter chosen for the group.
+		best_ftype = fctx->group_ftype;
+		png_filter_row(best_ftype, cur, prev, bpl, filter_bpp, fctx->filtered[best_ftype]);
+	}
+	else {
+		u32 best_cost = 0;
+
+		// Try each filter, and choose the one with the lowest cost.
+		for(k=0; k<PNG_NUM_FILTERS; k++) {
+			u32 cost;
+
+			png_filter_row(k, cur, prev, bpl, filter_bpp, fctx->filtered[k]);
+			cost = png_filtered_row_cost(&fctx->filtered[k][1], bpl);
+			if(k==0 || cost<best_cost) {
+				best_cost = cost;
+				best_ftype = k;
+			}
+		}
+		fctx->group_ftype = best_ftype;
+	}
+
+	return fctx->filtered[best_ftype];
+}
+
+static int write_png_chunk_IDAT(struct deark_png_encode_info *pei, dbuf *cdbuf)
 {
-	int bpl = pei->width * pei->num_chans; // bytes per row in src_pixels
 	int y;
-	static const char nulbyte = '\0';
 	int retval = 0;
 	deark *c = pei->c;
 	struct fmtutil_tdefl_ctx *tdctx = NULL;
-	static const unsigned int my_s_tdefl_num_probes[11] = { 0, 1, 6, 32,  16, 32, 128, 256,  512, 768, 1500 };
+	struct png_filter_ctx fctx;
 
 	// compress image data
 	tdctx = fmtutil_tdefl_create(c, cdbuf,
-		my_s_tdefl_num_probes[MY_MZ_MIN(10, pei->level)] | MY_TDEFL_WRITE_ZLIB_HEADER);
+		png_get_tdefl_flags(pei) | MY_TDEFL_WRITE_ZLIB_HEADER);
+	png_filter_ctx_init(c, pei, &fctx);
 
 	for (y = 0; y < pei->height; ++y) {
-		fmtutil_tdefl_compress_buffer(tdctx, &nulbyte, 1, FMTUTIL_TDEFL_NO_FLUSH);
-		fmtutil_tdefl_compress_buffer(tdctx, &src_pixels[(pei->flip ? (pei->height - 1 - y) : y) * bpl],
-			bpl, FMTUTIL_TDEFL_NO_FLUSH);
+		fmtutil_tdefl_compress_buffer(tdctx, png_filter_row_auto(pei, y, &fctx),
+			(size_t)pei->bpl+1, FMTUTIL_TDEFL_NO_FLUSH);
 	}
 	if (fmtutil_tdefl_compress_buffer(tdctx, NULL, 0, FMTUTIL_TDEFL_FINISH) !=
 		FMTUTIL_TDEFL_STATUS_DONE)
@@ -160,13 +371,209 @@ static int write_png_chunk_IDAT(struct deark_png_encode_info *pei, dbuf *cdbuf,
 
 done:
 	fmtutil_tdefl_destroy(tdctx);
+	png_filter_ctx_free(c, &fctx);
+	return retval;
+}
+
+// Level 0: Write the image data as "stored" (uncompressed) Deflate blocks.
+// This is mainly useful when speed is all that matters. Blocks are made as
+// large as Deflate allows (65535 bytes), and may span rows.
+#define PNG_STORED_BLOCK_SIZE 65535
+
+static void png_write_stored_block(dbuf *cdbuf, const u8 *buf, i64 len,
+	int is_final)
+{
+	dbuf_writebyte(cdbuf, is_final ? 0x01 : 0x00);
+	dbuf_writeu16le(cdbuf, len);
+	dbuf_writeu16le(cdbuf, (~len) & 0xffff);
+	dbuf_write(cdbuf, buf, len);
+}
+
+static int write_png_chunk_IDAT_stored(struct deark_png_encode_info *pei, dbuf *cdbuf)
+{
+	deark *c = pei->c;
+	struct de_crcobj *adlero = NULL;
+	struct png_filter_ctx fctx;
+	u8 *blk = NULL;
+	i64 blk_len = 0;
+	int y;
+
+	adlero = de_crcobj_create(c, DE_CRCOBJ_ADLER32);
+	png_filter_ctx_init(c, pei, &fctx);
+	blk = de_malloc(c, PNG_STORED_BLOCK_SIZE);
+
+	// zlib header (deflate, 32K window, "fastest" level hint)
+	dbuf_writebyte(cdbuf, 0x78);
+	dbuf_writebyte(cdbuf, 0x01);
+
+	for(y=0; y<pei->height; y++) {
+		const u8 *row;
+		i64 row_len = (i64)pei->bpl+1;
+		i64 pos = 0;
+
+		row = png_filter_row_auto(pei, y, &fctx);
+		de_crcobj_addbuf(adlero, row, row_len);
+
+		while(pos < row_len) {
+			i64 n;
+
+			if(blk_len == PNG_STORED_BLOCK_SIZE) {
+				png_write_stored_block(cdbuf, blk, blk_len, 0);
+				blk_len = 0;
+			}
+			n = de_min_int(row_len - pos, PNG_STORED_BLOCK_SIZE - blk_len);
+			de_memcpy(&blk[blk_len], &row[pos], (size_t)n);
+			blk_len += n;
+			pos += n;
+		}
+	}
+	png_write_stored_block(cdbuf, blk, blk_len, 1);
+
+	dbuf_writeu32be(cdbuf, (i64)de_crcobj_getval(adlero));
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_IDAT);
+
+	de_free(c, blk);
+	png_filter_ctx_free(c, &fctx);
+	de_crcobj_destroy(adlero);
+	return 1;
+}
+
+// Multithreaded compression:
+// The image is divided into strips of rows. Each strip is filtered and
+// compressed independently, as a raw Deflate stream ending with a sync flush
+// (except for the last strip), and the results are concatenated. The Adler-32
+// checksums of the strips are combined.
+
+// Approximate amount of (filtered) image data in a strip.
+#define PNG_STRIP_SIZE (256*1024)
+// Smaller images are always compressed with one thread.
+#define PNG_MT_MIN_SIZE (1024*1024)
+#define PNG_MAX_THREADS 64
+
+struct png_stripjob {
+	struct deark_png_encode_info *pei;
+	int y_start;
+	int num_rows;
+	u8 is_last_strip;
+	u8 ok;
+	dbuf *cmpr_data;
+	u32 adler;
+};
+
+// May be called by a separate thread.
+static void png_stripjob_run(void *userdata)
+{
+	struct png_stripjob *sj = (struct png_stripjob*)userdata;
+	struct deark_png_encode_info *pei = sj->pei;
+	deark *c = pei->c;
+	struct fmtutil_tdefl_ctx *tdctx = NULL;
+	struct de_crcobj *adlero = NULL;
+	struct png_filter_ctx fctx;
+	enum fmtutil_tdefl_status ret;
+	int y;
+
+	sj->cmpr_data = dbuf_create_membuf(c, 0, 0);
+	tdctx = fmtutil_tdefl_create(c, sj->cmpr_data, png_get_tdefl_flags(pei));
+	adlero = de_crcobj_create(c, DE_CRCOBJ_ADLER32);
+	png_filter_ctx_init(c, pei, &fctx);
+
+	for(y=sj->y_start; y<sj->y_start+sj->num_rows; y++) {
+		const u8 *row;
+
+		row = png_filter_row_auto(pei, y, &fctx);
+		de_crcobj_addbuf(adlero, row, (i64)pei->bpl+1);
+		fmtutil_tdefl_compress_buffer(tdctx, row, (size_t)pei->bpl+1,
+			FMTUTIL_TDEFL_NO_FLUSH);
+	}
+
+	ret = fmtutil_tdefl_compress_buffer(tdctx, NULL, 0,
+		sj->is_last_strip ? FMTUTIL_TDEFL_FINISH : FMTUTIL_TDEFL_SYNC_FLUSH);
+	sj->ok = (ret == (sj->is_last_strip ? FMTUTIL_TDEFL_STATUS_DONE :
+		FMTUTIL_TDEFL_STATUS_OKAY));
+	sj->adler = de_crcobj_getval(adlero);
+
+	fmtutil_tdefl_destroy(tdctx);
+	de_crcobj_destroy(adlero);
+	png_filter_ctx_free(c, &fctx);
+}
+
+static int write_png_chunk_IDAT_mt(struct deark_png_encode_info *pei, dbuf *cdbuf)
+{
+	deark *c = pei->c;
+	struct png_stripjob *strips = NULL;
+	void *jobs[PNG_MAX_THREADS];
+	struct de_crcobj *adlero = NULL;
+	int rows_per_strip;
+	int y;
+	int i;
+	int num_strips;
+	u8 flevel;
+	int failed = 0;
+	int retval = 0;
+
+	rows_per_strip = de_max_int(1, PNG_STRIP_SIZE / (pei->bpl+1));
+	strips = de_mallocarray(c, pei->num_threads, sizeof(struct png_stripjob));
+	adlero = de_crcobj_create(c, DE_CRCOBJ_ADLER32);
+
+	// zlib header, with a compression level hint similar to what miniz uses
+	if(pei->fast || pei->level<2) flevel = 0;
+	else if(pei->level<6) flevel = 1;
+	else if(pei->level==6) flevel = 2;
+	else flevel = 3;
+	dbuf_writebyte(cdbuf, 0x78);
+	dbuf_writebyte(cdbuf, (u8)((flevel<<6) | (31 - ((0x78*256 + (flevel<<6)) % 31))));
+
+	y = 0;
+	while(y < pei->height) {
+		// Compress up to num_threads strips at once.
+		num_strips = 0;
+		while(num_strips < pei->num_threads && y < pei->height) {
+			struct png_stripjob *sj = &strips[num_strips];
+
+			de_zeromem(sj, sizeof(struct png_stripjob));
+			sj->pei = pei;
+			sj->y_start = y;
+			sj->num_rows = de_min_int(rows_per_strip, pei->height - y);
+			y += sj->num_rows;
+			sj->is_last_strip = (y >= pei->height);
+			jobs[num_strips] = (void*)sj;
+			num_strips++;
+		}
+
+		de_run_jobs_in_parallel(c, png_stripjob_run, jobs, (i64)num_strips,
+			pei->num_threads);
+
+		for(i=0; i<num_strips; i++) {
+			struct png_stripjob *sj = &strips[i];
+
+			if(sj->ok) {
+				dbuf_copy(sj->cmpr_data, 0, sj->cmpr_data->len, cdbuf);
+				de_crcobj_combine(adlero, sj->adler, (i64)sj->num_rows * (pei->bpl+1));
+			}
+			else {
+				failed = 1;
+			}
+			dbuf_close(sj->cmpr_data);
+			sj->cmpr_data = NULL;
+		}
+		if(failed) goto done;
+	}
+
+	dbuf_writeu32be(cdbuf, (i64)de_crcobj_getval(adlero));
+	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_IDAT);
+	retval = 1;
+
+done:
+	de_crcobj_destroy(adlero);
+	de_free(c, strips);
 	return retval;
 }
 
-static int do_generate_png(struct deark_png_encode_info *pei, const u8 *src_pixels)
+static int do_generate_png(struct deark_png_encode_info *pei)
 {
 	static const u8 pngsig[8] = { 0x89,0x50,0x4e,0x47,0x0d,0x0a,0x1a,0x0a };
 	dbuf *cdbuf = NULL;
+	i64 t0;
 	int retval = 0;
 
 	// A membuf that we'll use and reuse for each chunk's data
@@ -196,8 +603,36 @@ static int do_generate_png(struct deark_png_encode_info *pei, const u8 *src_pixe
 		write_png_chunk_tEXt(pei, cdbuf, "Software", "Deark");
 	}
 
+	if(pei->color_type==3) {
+		dbuf_truncate(cdbuf, 0);
+		write_png_chunk_PLTE(pei, cdbuf);
+		if(pei->num_trns_entries>0) {
+			dbuf_truncate(cdbuf, 0);
+			write_png_chunk_tRNS(pei, cdbuf);
+		}
+	}
+
 	dbuf_truncate(cdbuf, 0);
-	if(!write_png_chunk_IDAT(pei, cdbuf, src_pixels)) goto done;
+	t0 = de_get_highres_time_ns();
+	if(pei->level==0 && !pei->fast) {
+		if(!write_png_chunk_IDAT_stored(pei, cdbuf)) goto done;
+	}
+	else if(pei->num_threads>1 && (i64)pei->height*(pei->bpl+1) >= PNG_MT_MIN_SIZE) {
+		if(!write_png_chunk_IDAT_mt(pei, cdbuf)) goto done;
+	}
+	else {
+		if(!write_png_chunk_IDAT(pei, cdbuf)) goto done;
+	}
+	if(pei->c->debug_level>=1) {
+		i64 t1;
+		i64 rawlen = (i64)pei->height*(pei->bpl+1);
+
+		t1 = de_get_highres_time_ns() - t0;
+		de_dbg(pei->c, "PNG image data: %"I64_FMT" bytes -> %"I64_FMT", "
+			"%.3f ms (%.1f MB/s)", rawlen, cdbuf->len,
+			(double)t1/1000000.0,
+			(t1>0) ? ((double)rawlen*1000.0/(double)t1) : 0.0);
+	}
 
 	dbuf_truncate(cdbuf, 0);
 	write_png_chunk_from_cdbuf(pei, cdbuf, CODE_IEND);
@@ -208,9 +643,207 @@ done:
 	return retval;
 }
 
+#define PNG_PAL_HASH_SIZE 1024 // Must be a power of 2, and more than 256
+
+// Returns the color of the given pixel, as a key for the palette hash table.
+static u32 png_get_pixel_key(const u8 *p, int num_chans)
+{
+	switch(num_chans) {
+	case 1:
+		return DE_MAKE_GRAY(p[0]);
+	case 2:
+		return DE_SET_ALPHA(DE_MAKE_GRAY(p[0]), p[1]);
+	case 3:
+		return DE_MAKE_RGB(p[0], p[1], p[2]);
+	}
+	return DE_MAKE_RGBA(p[0], p[1], p[2], p[3]);
+}
+
+// If all the colors are opaque gray levels, returns the smallest grayscale
+// bit depth (1, 2, 4, or 8) that can represent them exactly. Otherwise
+// returns 0.
+static int png_get_gray_bit_depth(const u32 *pal, int num_colors)
+{
+	int bit_depth = 1;
+	int i;
+
+	for(i=0; i<num_colors; i++) {
+		u32 clr = pal[i];
+		u8 v = DE_COLOR_R(clr);
+
+		if(DE_COLOR_A(clr)!=0xff || DE_COLOR_G(clr)!=v || DE_COLOR_B(clr)!=v) {
+			return 0;
+		}
+		// The gray levels at bit depth n are the multiples of 255/(2^n-1).
+		while(bit_depth<8 && v%(255/((1<<bit_depth)-1))!=0) {
+			bit_depth *= 2;
+		}
+	}
+	return bit_depth;
+}
+
+// If the image has few enough colors, convert it to paletted form, and set
+// pei->color_type to 3. But if it is opaque, and all its colors are gray
+// levels that grayscale can represent at no more bits per pixel, convert it
+// to grayscale instead, which needs no PLTE chunk. Otherwise, leave pei
+// unchanged.
+// Opaque grayscale images are only converted if that lets us use a bit
+// depth less than 8.
+static void png_try_palette(struct deark_png_encode_info *pei, const u8 *src_pixels)
+{
+	deark *c = pei->c;
+	u32 *ht_keys = NULL;
+	u8 *ht_idx = NULL;
+	u8 *ht_used = NULL;
+	u8 *rowidx = NULL; // 8-bit palette index for each pixel in a row
+	u8 new_order[256]; // Maps old palette index to new palette index
+	u32 tmppal[256];
+	int num_colors = 0;
+	int src_bpl;
+	int bit_depth;
+	int gray_bit_depth;
+	u8 use_gray = 0;
+	int i, j, x, y;
+	u32 prev_key = 0;
+	u8 prev_idx = 0;
+
+	src_bpl = pei->width * pei->num_chans;
+
+	ht_keys = de_mallocarray(c, PNG_PAL_HASH_SIZE, sizeof(u32));
+	ht_idx = de_malloc(c, PNG_PAL_HASH_SIZE);
+	ht_used = de_malloc(c, PNG_PAL_HASH_SIZE);
+
+	// Pass 1: Find the distinct colors, and give up if there are too many.
+	for(y=0; y<pei->height; y++) {
+		const u8 *row = &src_pixels[(i64)y * src_bpl];
+
+		for(x=0; x<pei->width; x++) {
+			u32 key;
+			u32 h;
+
+			key = png_get_pixel_key(&row[x*pei->num_chans], pei->num_chans);
+			if(num_colors>0 && key==prev_key) continue;
+			prev_key = key;
+
+			h = (key * 0x9e3779b1U) >> 22;
+			while(ht_used[h] && ht_keys[h]!=key) {
+				h = (h+1) & (PNG_PAL_HASH_SIZE-1);
+			}
+			if(ht_used[h]) continue;
+
+			if(num_colors>=256) goto done;
+			ht_used[h] = 1;
+			ht_keys[h] = key;
+			ht_idx[h] = (u8)num_colors;
+			tmppal[num_colors] = key;
+			num_colors++;
+		}
+	}
+
+	if(num_colors<=2) bit_depth = 1;
+	else if(num_colors<=4) bit_depth = 2;
+	else if(num_colors<=16) bit_depth = 4;
+	else bit_depth = 8;
+
+	gray_bit_depth = png_get_gray_bit_depth(tmppal, num_colors);
+	if(gray_bit_depth>0 && gray_bit_depth<=bit_depth) {
+		// No need for a PLTE chunk
+		use_gray = 1;
+		bit_depth = gray_bit_depth;
+	}
+
+	if(pei->num_chans==1 && bit_depth==8) goto done;
+
+	if(use_gray) goto write_pixels;
+
+	// Put the colors that aren't fully opaque first, so that the tRNS chunk
+	// can be as short as possible.
+	pei->num_trns_entries = 0;
+	for(i=0; i<num_colors; i++) {
+		if(DE_COLOR_A(tmppal[i])!=0xff) {
+			new_order[i] = (u8)pei->num_trns_entries;
+			pei->pal[pei->num_trns_entries++] = tmppal[i];
+		}
+	}
+	j = pei->num_trns_entries;
+	for(i=0; i<num_colors; i++) {
+		if(DE_COLOR_A(tmppal[i])==0xff) {
+			new_order[i] = (u8)j;
+			pei->pal[j++] = tmppal[i];
+		}
+	}
+	pei->num_pal_entries = num_colors;
+	for(i=0; i<PNG_PAL_HASH_SIZE; i++) {
+		if(ht_used[i]) ht_idx[i] = new_order[ht_idx[i]];
+	}
+
+write_pixels:
+	// Pass 2: Write the packed palette indices (or gray levels).
+	pei->bpl = (pei->width * bit_depth + 7)/8;
+	pei->idx_pixels = de_mallocarray(c, pei->height, (i64)pei->bpl);
+	rowidx = de_malloc(c, (i64)pei->width);
+	for(y=0; y<pei->height; y++) {
+		const u8 *row = &src_pixels[(i64)y * src_bpl];
+		u8 *dstrow = &pei->idx_pixels[(i64)y * pei->bpl];
+
+		for(x=0; x<pei->width; x++) {
+			u32 key;
+			u32 h;
+
+			if(use_gray) {
+				rowidx[x] = row[x*pei->num_chans] >> (8-bit_depth);
+				continue;
+			}
+
+			key = png_get_pixel_key(&row[x*pei->num_chans], pei->num_chans);
+			if(x>0 && key==prev_key) {
+				rowidx[x] = prev_idx;
+				continue;
+			}
+
+			h = (key * 0x9e3779b1U) >> 22;
+			while(ht_keys[h]!=key) {
+				h = (h+1) & (PNG_PAL_HASH_SIZE-1);
+			}
+			rowidx[x] = ht_idx[h];
+			prev_key = key;
+			prev_idx = rowidx[x];
+		}
+
+		if(bit_depth==8) {
+			de_memcpy(dstrow, rowidx, (size_t)pei->width);
+		}
+		else {
+			int ppb = 8/bit_depth; // pixels per byte
+
+			for(x=0; x<pei->width; x++) {
+				dstrow[x/ppb] |= (u8)(rowidx[x] << (8 - bit_depth*(x%ppb+1)));
+			}
+		}
+	}
+
+	if(use_gray) {
+		pei->color_type = 0;
+		pei->num_chans = 1;
+	}
+	else {
+		pei->color_type = 3;
+	}
+	pei->bit_depth = (u8)bit_depth;
+	pei->src_pixels = pei->idx_pixels;
+
+done:
+	de_free(c, ht_keys);
+	de_free(c, ht_idx);
+	de_free(c, ht_used);
+	de_free(c, rowidx);
+}
+
 int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 {
+	static const u8 color_type_code[] = {0x00, 0x00, 0x04, 0x02, 0x06};
 	const char *opt_level;
+	const char *opt_threads;
 	int retval = 0;
 	struct deark_png_encode_info *pei = NULL;
 
@@ -261,6 +894,10 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 	pei->height = (int)img->height;
 	pei->flip = img->flipped;
 	pei->num_chans = img->bytes_per_pixel;
+	pei->src_pixels = img->bitmap;
+	pei->bpl = pei->width * pei->num_chans;
+	pei->color_type = color_type_code[pei->num_chans];
+	pei->bit_depth = 8;
 	pei->include_text_chunk_software = 0;
 
 	if(!c->pngcprlevel_valid) {
@@ -268,7 +905,10 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 		c->pngcprlevel_valid = 1;
 
 		opt_level = de_get_ext_option(c, "pngcmprlevel");
-		if(opt_level) {
+		if(opt_level && !de_strcmp(opt_level, "fast")) {
+			c->pngcmpr_fast = 1;
+		}
+		else if(opt_level) {
 			i64 opt_level_n = de_atoi64(opt_level);
 			if(opt_level_n>10) {
 				c->pngcmprlevel = 10;
@@ -282,6 +922,15 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 		}
 	}
 	pei->level = c->pngcmprlevel;
+	pei->fast = c->pngcmpr_fast;
+
+	pei->num_threads = 1;
+	opt_threads = de_get_ext_option(c, "png:threads");
+	if(opt_threads) {
+		pei->num_threads = (int)de_atoi64(opt_threads);
+		if(pei->num_threads<1) pei->num_threads = 1;
+		if(pei->num_threads>PNG_MAX_THREADS) pei->num_threads = PNG_MAX_THREADS;
+	}
 
 	if(f->fi_copy && f->fi_copy->internal_mod_time.is_valid) {
 		pei->internal_mod_time = f->fi_copy->internal_mod_time;
@@ -295,9 +944,11 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 		pei->include_text_chunk_software = 1;
 	}
 
+	png_try_palette(pei, img->bitmap);
+
 	pei->crco = de_crcobj_create(c, DE_CRCOBJ_CRC32_IEEE);
 
-	if(!do_generate_png(pei, img->bitmap)) {
+	if(!do_generate_png(pei)) {
 		de_err(c, "PNG write failed");
 		goto done;
 	}
@@ -307,6 +958,7 @@ int de_write_png(deark *c, de_bitmap *img, dbuf *f)
 done:
 	if(pei) {
 		de_crcobj_destroy(pei->crco);
+		de_free(c, pei->idx_pixels);
 		de_free(c, pei);
 	}
 	return retval;
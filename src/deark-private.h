@@ -77,12 +77,25 @@ typedef int (*de_module_identify_fn)(deark *c);
 
 typedef void (*de_module_help_fn)(deark *c);
 
+// A "magic number" that identifies a format.
+struct deark_module_sig {
+	i64 pos; // Offset in the file
+	const char *sig;
+	size_t len;
+	int confidence; // Ignored if the module has an identify_fn
+};
+
 struct deark_module_info {
 	const char *id;
 	const char *desc;
 	const char *desc2; // Additional notes
 	de_module_run_fn run_fn;
 	de_module_identify_fn identify_fn;
+	// Optional signature table.
+	// If there is no identify_fn, the module is detected by signature alone.
+	// If there is an identify_fn, it is only called if a signature matches.
+	const struct deark_module_sig *sigs;
+	size_t num_sigs;
 	de_module_help_fn help_fn;
 #define DE_MODFLAG_HIDDEN       0x01 // Do not list
 #define DE_MODFLAG_NONWORKING   0x02 // Do not list, and print a warning
@@ -157,11 +170,24 @@ struct dbuf_struct {
 
 	u8 write_memfile_to_zip_archive;
 	u8 writing_to_tar_archive;
+	u8 writing_to_zip_stream;
+	// For recursive mode: This output file is being held in memory, and hasn't
+	// been written anywhere yet.
+	u8 recurse_pending;
+	int output_file_index;
 	char *name; // used for DBUF_TYPE_OFILE (utf-8)
 
 	i64 membuf_alloc;
 	u8 *membuf_buf;
 
+	// Write-combining buffer: If write_combining is set, small writes are
+	// collected in wcbuf, and passed on in larger blocks. Bytes in wcbuf are
+	// already counted in ->len, and have already been seen by the write
+	// listener.
+	u8 write_combining;
+	i64 wcbuf_used;
+	u8 *wcbuf;
+
 	void *userdata_for_writelistener;
 	de_writelistener_cb_type writelistener_cb;
 	void *userdata_for_customread;
@@ -175,12 +201,24 @@ struct dbuf_struct {
 	i64 cache_start_pos;
 	i64 cache_bytes_used;
 	u8 *cache;
+	// If set, ->cache is a read-only memory-mapped view of the whole file,
+	// and must be released with de_munmap() instead of de_free().
+	u8 cache_is_mmap;
+	void *mmap_handle;
+
+	// Optional cache of recently-read blocks, for file data not covered by
+	// ->cache.
+	struct dbuf_blockcache *bcache;
 
 	// cache2 is a simple 1-byte cache, mainly to speed up de_convert_row_bilevel().
 	i64 cache2_start_pos;
 	i64 cache2_bytes_used;
 	u8 cache2[1];
 
+	// Approximately the number of bytes that have been read from this dbuf.
+	// Only used for statistics.
+	i64 num_bytes_read;
+
 	// Things copied from the de_finfo object at file creation
 	de_finfo *fi_copy;
 };
@@ -206,6 +244,11 @@ struct de_finfo_struct {
 	u8 orig_name_was_dot; // Internal use
 	u8 has_hotspot;
 
+	// If the module knows the size the file will have (e.g. from an archive
+	// member header), it can set this. It's used by -l -opt list:size.
+	u8 len_known;
+	i64 len;
+
 #define DE_MODEFLAG_NONEXE 0x01 // Make the output file non-executable.
 #define DE_MODEFLAG_EXE    0x02 // Make the output file executable.
 	unsigned int mode_flags;
@@ -335,6 +378,8 @@ struct deark_struct {
 
 	// Always valid during identify(); can be NULL during run().
 	struct de_detection_data_struct *detection_data;
+	struct de_detection_index *detection_index;
+	struct de_detection_profile *detection_profile;
 	////////////////////////////////////////////////////
 
 	int file_count; // The number of extractable files encountered so far.
@@ -344,6 +389,7 @@ struct deark_struct {
 	int num_files_extracted;
 
 	i64 total_output_size;
+	int num_main_files_created; // Files created without DE_CREATEFLAG_IS_AUX
 	int error_count;
 	u8 serious_error_flag;
 
@@ -365,6 +411,7 @@ struct deark_struct {
 	int extract_level;
 	u8 list_mode;
 	u8 list_mode_include_file_id;
+	u8 list_mode_include_size;
 	int first_output_file; // first file = 0
 	int max_output_files; // -1 = no limit
 	i64 max_image_dimension;
@@ -402,10 +449,17 @@ struct deark_struct {
 	u8 tmpflag2;
 	u8 pngcprlevel_valid;
 	unsigned int pngcmprlevel;
+	u8 pngcmpr_fast;
 	void *zip_data;
 	void *tar_data;
 	dbuf *extrlist_dbuf;
 
+	// Recursive mode ("-opt recurse")
+	int recurse_max_depth; // 0 = disabled
+	int recurse_depth;
+	u8 recurse_keep_all;
+	i64 recurse_budget; // Number of bytes we may still look inside
+
 	char *base_output_filename;
 	char *output_archive_filename;
 	char *extrlist_filename;
@@ -428,6 +482,7 @@ struct deark_struct {
 };
 
 void de_fatalerror(deark *c);
+int de_recurse_into_output_file(deark *c, dbuf *f);
 
 deark *de_create_internal(void);
 int de_run_module(deark *c, struct deark_module_info *mi, de_module_params *mparams,
@@ -488,8 +543,18 @@ FILE* de_fopen_for_write(deark *c, const char *fn,
 int de_fseek(FILE *fp, i64 offs, int whence);
 i64 de_ftell(FILE *fp);
 int de_fclose(FILE *fp);
+const u8 *de_mmap_for_read(deark *c, FILE *fp, i64 len, void **phandle);
+void de_munmap(deark *c, const u8 *mem, i64 len, void *handle);
 void de_update_file_attribs(dbuf *f, u8 preserve_file_times);
 
+typedef void (*de_thread_fn_type)(void *userdata);
+struct de_thread_struct;
+typedef struct de_thread_struct de_thread;
+de_thread *de_thread_create(deark *c, de_thread_fn_type fn, void *userdata);
+void de_thread_join(deark *c, de_thread *t);
+void de_run_jobs_in_parallel(deark *c, de_thread_fn_type fn, void **jobs,
+	i64 num_jobs, int max_threads);
+
 void de_declare_fmt(deark *c, const char *fmtname);
 void de_declare_fmtf(deark *c, const char *fmt, ...)
   de_gnuc_attribute ((format (printf, 2, 3)));
@@ -535,6 +600,8 @@ void de_tar_close_file(deark *c);
 
 int de_zip_create_file(deark *c);
 void de_zip_add_file_to_archive(deark *c, dbuf *f);
+void de_zip_start_streaming_member(deark *c, dbuf *f);
+void de_zip_end_streaming_member(deark *c, dbuf *f);
 void de_zip_close_file(deark *c);
 
 int de_write_png(deark *c, de_bitmap *img, dbuf *f);
@@ -638,7 +705,7 @@ void dbuf_read_to_ucstring_n(dbuf *f, i64 pos, i64 len, i64 max_len,
 
 // At least one of 'ext' or 'fi' should be non-NULL.
 #define DE_CREATEFLAG_IS_AUX   0x1
-#define DE_CREATEFLAG_OPT_IMAGE 0x2
+#define DE_CREATEFLAG_NO_RECURSE 0x4 // Don't look inside this file in recursive mode
 dbuf *dbuf_create_output_file(deark *c, const char *ext, de_finfo *fi, unsigned int createflags);
 
 dbuf *dbuf_create_unmanaged_file(deark *c, const char *fname, int overwrite_mode, unsigned int flags);
@@ -684,6 +751,7 @@ void dbuf_puts(dbuf *f, const char *sz);
 void dbuf_printf(dbuf *f, const char *fmt, ...)
   de_gnuc_attribute ((format (printf, 2, 3)));
 void dbuf_flush(dbuf *f);
+int dbuf_is_discarded(dbuf *f);
 
 // Read a slice of one dbuf, and append it to another dbuf.
 void dbuf_copy(dbuf *inf, i64 input_offset, i64 input_len, dbuf *outf);
@@ -779,6 +847,14 @@ void de_bitmap_setpixel_rgb(de_bitmap *img, i64 x, i64 y,
 void de_bitmap_setpixel_rgba(de_bitmap *img, i64 x, i64 y,
 	u32 color);
 
+// Set n pixels in row y, starting at x. Pixels that don't fit are ignored.
+void de_bitmap_setpixels_rgba(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u32 *clrs);
+void de_bitmap_setpixels_paletted(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u8 *idx, const u32 *pal);
+void de_bitmap_setpixels_gray(de_bitmap *img, i64 x, i64 y, i64 n,
+	const u8 *samples);
+
 u32 de_bitmap_getpixel(de_bitmap *img, i64 x, i64 y);
 
 de_bitmap *de_bitmap_create_noinit(deark *c);
@@ -814,6 +890,14 @@ u8 de_get_bits_symbol2(dbuf *f, int nbits, i64 bytepos, i64 bitpos);
 #define DE_CVTF_WHITEISZERO 0x1
 #define DE_CVTF_LSBFIRST    0x2
 
+void de_unpack_pixels(const u8 *src, i64 bps, i64 n, u8 *dst, unsigned int flags);
+
+// Read a row of packed 1, 2, 4, or 8-bit palette indices, and write it to
+// row 'rownum' of a bitmap.
+// flags: DE_CVTF_LSBFIRST
+void de_convert_row_paletted(dbuf *f, i64 fpos, i64 bpp, const u32 *pal,
+	de_bitmap *img, i64 rownum, unsigned int flags);
+
 // Utility function for the common case of reading a packed bi-level row, and
 // writing to a bitmap.
 void de_convert_row_bilevel(dbuf *f, i64 fpos, de_bitmap *img,
@@ -836,6 +920,9 @@ void de_convert_image_paletted(dbuf *f, i64 fpos,
 	i64 bpp, i64 rowspan, const u32 *pal,
 	de_bitmap *img, unsigned int flags);
 
+void de_convert_row_rgb(dbuf *f, i64 fpos, i64 pixelspan,
+	de_bitmap *img, i64 rownum, unsigned int flags);
+
 void de_convert_image_rgb(dbuf *f, i64 fpos,
 	i64 rowspan, i64 pixelspan, de_bitmap *img, unsigned int flags);
 
@@ -1016,6 +1103,7 @@ int de_inthashtable_remove_any_item(deark *c, struct de_inthashtable *ht, i64 *p
 #define DE_CRCOBJ_CRC32_IEEE   0x10
 #define DE_CRCOBJ_CRC16_CCITT  0x20
 #define DE_CRCOBJ_CRC16_ARC    0x21
+#define DE_CRCOBJ_ADLER32      0x30
 
 struct de_crcobj;
 
@@ -1026,6 +1114,9 @@ u32 de_crcobj_getval(struct de_crcobj *crco);
 void de_crcobj_addbuf(struct de_crcobj *crco, const u8 *buf, i64 buf_len);
 void de_crcobj_addbyte(struct de_crcobj *crco, u8 b);
 void de_crcobj_addslice(struct de_crcobj *crco, dbuf *f, i64 pos, i64 len);
+void de_crcobj_combine(struct de_crcobj *crco, u32 crc2, i64 len2);
+void de_crc_init_tables(void);
+int de_crc_selftest(deark *c);
 
 ///////////////////////////////////////////
 
@@ -1165,3 +1256,4 @@ char *de_dbg_timestamp_to_string(deark *c, const struct de_timestamp *ts,
 void de_gmtime(const struct de_timestamp *ts, struct de_struct_tm *tm2);
 void de_current_time_to_timestamp(struct de_timestamp *ts);
 void de_cached_current_time_to_timestamp(deark *c, struct de_timestamp *ts);
+i64 de_get_highres_time_ns(void);
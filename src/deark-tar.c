@@ -30,11 +30,21 @@ struct tar_md {
 	struct timestamp_data tsdata[DE_TIMESTAMPIDX_COUNT];
 };
 
+// When writing to stdout, we can't go back and write the headers after the
+// member data, so the member data is spooled here first. It is held in
+// memory, unless it gets larger than this.
+#define TAR_SPOOL_MAX_MEM_SIZE (8*1024*1024)
+
 struct tar_ctx {
 	const char *tar_filename;
 	dbuf *outf;
+	u8 outf_is_seekable;
 	i64 checksum_calc; // for temporary use
 
+	// Used if !outf_is_seekable
+	dbuf *spool_mem;
+	FILE *spool_fp; // If not NULL, the spooled data is here instead
+
 	// Data associated with current member file
 	struct tar_md *md;
 };
@@ -51,22 +61,21 @@ int de_tar_create_file(deark *c)
 
 	if(c->archive_to_stdout) {
 		tctx->tar_filename = "[stdout]";
-		de_err(c, "TAR to stdout is not implemented");
-		de_fatalerror(c);
-		goto done;
-	}
-
-
-	if(c->output_archive_filename) {
-		tctx->tar_filename = c->output_archive_filename;
+		tctx->outf = dbuf_create_unmanaged_file_stdout(c, "[TAR stdout stream]");
 	}
 	else {
-		tctx->tar_filename = "output.tar";
-	}
+		if(c->output_archive_filename) {
+			tctx->tar_filename = c->output_archive_filename;
+		}
+		else {
+			tctx->tar_filename = "output.tar";
+		}
 
-	de_info(c, "Creating %s", tctx->tar_filename);
-	tctx->outf = dbuf_create_unmanaged_file(c, tctx->tar_filename,
-		c->overwrite_mode, 0);
+		de_info(c, "Creating %s", tctx->tar_filename);
+		tctx->outf = dbuf_create_unmanaged_file(c, tctx->tar_filename,
+			c->overwrite_mode, 0);
+		tctx->outf_is_seekable = 1;
+	}
 
 	if(tctx->outf->btype==DBUF_TYPE_NULL) {
 		de_fatalerror(c);
@@ -96,10 +105,90 @@ void de_tar_close_file(deark *c)
 		dbuf_close(tctx->outf);
 	}
 	destroy_md(c, tctx->md);
+	dbuf_close(tctx->spool_mem);
+	if(tctx->spool_fp) fclose(tctx->spool_fp);
 	de_free(c, tctx);
 	c->tar_data = NULL;
 }
 
+// The member's size is already decided by the time we spool it, so if the
+// temporary file fails us, there's no way to write a valid tar file.
+static void spool_io_error(deark *c)
+{
+	de_err(c, "Failed to write or read temporary file");
+	de_fatalerror(c);
+}
+
+static void spool_fwrite(deark *c, struct tar_ctx *tctx, const u8 *buf, i64 buf_len)
+{
+	if(buf_len<1) return;
+	if(fwrite(buf, 1, (size_t)buf_len, tctx->spool_fp) != (size_t)buf_len) {
+		spool_io_error(c);
+	}
+}
+
+static void spool_write_cbfn(dbuf *f, void *userdata, const u8 *buf, i64 buf_len)
+{
+	struct tar_ctx *tctx = (struct tar_ctx*)userdata;
+	deark *c = f->c;
+
+	if(!tctx->spool_fp) {
+		if(tctx->spool_mem->len + buf_len <= TAR_SPOOL_MAX_MEM_SIZE) {
+			dbuf_write(tctx->spool_mem, buf, buf_len);
+			return;
+		}
+
+		// Too big to keep in memory. Move it to a temporary file.
+		de_dbg(c, "spooling %s to a temporary file", f->name);
+		tctx->spool_fp = tmpfile();
+		if(!tctx->spool_fp) {
+			de_err(c, "Failed to create temporary file");
+			de_fatalerror(c);
+			return;
+		}
+		spool_fwrite(c, tctx, tctx->spool_mem->membuf_buf, tctx->spool_mem->len);
+		dbuf_truncate(tctx->spool_mem, 0);
+	}
+
+	spool_fwrite(c, tctx, buf, buf_len);
+}
+
+// Copy the spooled member file data to the tar file.
+static void write_spooled_data(deark *c, struct tar_ctx *tctx, i64 len)
+{
+	u8 buf[32768];
+	i64 nbytes_left;
+
+	if(!tctx->spool_fp) {
+		dbuf_copy(tctx->spool_mem, 0, tctx->spool_mem->len, tctx->outf);
+		dbuf_truncate(tctx->spool_mem, 0);
+		return;
+	}
+
+	// (Buffered write errors may not show up until now.)
+	if(fflush(tctx->spool_fp)!=0 || ferror(tctx->spool_fp)) {
+		spool_io_error(c);
+		return;
+	}
+	rewind(tctx->spool_fp);
+	nbytes_left = len;
+	while(nbytes_left>0) {
+		size_t n;
+		size_t n_wanted;
+
+		n_wanted = (size_t)de_min_int(nbytes_left, (i64)sizeof(buf));
+		n = fread(buf, 1, n_wanted, tctx->spool_fp);
+		if(n!=n_wanted) {
+			spool_io_error(c);
+			return;
+		}
+		dbuf_write(tctx->outf, buf, (i64)n);
+		nbytes_left -= (i64)n;
+	}
+	fclose(tctx->spool_fp);
+	tctx->spool_fp = NULL;
+}
+
 static void prepare_timestamp_exthdr(deark *c, struct tar_md *md, int tsidx)
 {
 	i64 unix_time;
@@ -141,6 +230,8 @@ static void prepare_timestamp_exthdr(deark *c, struct tar_md *md, int tsidx)
 // f is type DBUF_TYPE_ODBUF, in the process of being created.
 // We are responsible for setting f->parent_dbuf and
 // f->offset_into_parent_dbuf.
+// If the tar file is not seekable, we instead change f to a custom dbuf
+// that spools its data.
 void de_tar_start_member_file(deark *c, dbuf *f)
 {
 	struct tar_ctx *tctx = NULL;
@@ -237,6 +328,19 @@ void de_tar_start_member_file(deark *c, dbuf *f)
 		md->headers_size = 512;
 	}
 
+	if(!tctx->outf_is_seekable) {
+		// We'll write the headers when we know the member file size.
+		if(!tctx->spool_mem) {
+			tctx->spool_mem = dbuf_create_membuf(c, 0, 0);
+		}
+		f->btype = DBUF_TYPE_CUSTOM;
+		f->parent_dbuf = NULL;
+		f->customwrite_fn = spool_write_cbfn;
+		f->userdata_for_customwrite = (void*)tctx;
+		f->write_combining = 1;
+		return;
+	}
+
 	// Reserve space for the tar headers. We won't know the member file size
 	// until it has been completely written, so we can't write the headers
 	// yet. Instead we'll write them to headers_tmpdbuf, and seek back later
@@ -508,9 +612,11 @@ void de_tar_end_member_file(deark *c, dbuf *f)
 	dbuf *exthdr = NULL;
 	dbuf *extdata = NULL;
 
-	// Write any needed padding to the main tar file.
 	padded_len = de_pad_to_n(f->len, 512);
-	dbuf_write_zeroes(tctx->outf, padded_len - f->len);
+	if(tctx->outf_is_seekable) {
+		// Write any needed padding to the main tar file.
+		dbuf_write_zeroes(tctx->outf, padded_len - f->len);
+	}
 
 	// Construct the headers, using temporary dbufs
 
@@ -526,9 +632,22 @@ void de_tar_end_member_file(deark *c, dbuf *f)
 		make_exthdrs(c, tctx, f, exthdr, extdata);
 	}
 
+	if(!tctx->outf_is_seekable) {
+		// Write the headers, then the spooled data, then the padding.
+		if(md->has_exthdr && exthdr && extdata) {
+			dbuf_copy(exthdr, 0, 512, tctx->outf);
+			dbuf_copy(extdata, 0, 512*md->exthdr_num_data_blocks, tctx->outf);
+		}
+		dbuf_copy(mainhdr, 0, 512, tctx->outf);
+		write_spooled_data(c, tctx, f->len);
+		dbuf_write_zeroes(tctx->outf, padded_len - f->len);
+		goto done;
+	}
+
 	// Seek back and write the headers to the main tar file.
 	// FIXME: This is a hack, sort of. A dbuf doesn't expect us to access its
 	// fp pointer, or to mix copy_at with other 'write' functions.
+	dbuf_flush(tctx->outf);
 	saved_pos = de_ftell(tctx->outf->fp);
 	writepos = md->headers_pos;
 	if(md->has_exthdr && exthdr && extdata) {
@@ -540,6 +659,7 @@ void de_tar_end_member_file(deark *c, dbuf *f)
 	dbuf_copy_at(mainhdr, 0, 512, tctx->outf, writepos);
 	de_fseek(tctx->outf->fp, saved_pos, SEEK_SET);
 
+done:
 	dbuf_close(mainhdr);
 	dbuf_close(exthdr);
 	dbuf_close(extdata);
@@ -12,9 +12,13 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <utime.h>
 #include <errno.h>
+#include <pthread.h>
 
 // This file is overloaded, in that it contains functions intended to only
 // be used internally, as well as functions intended only for the
@@ -28,6 +32,12 @@ struct de_platform_data {
 	int reserved;
 };
 
+struct de_thread_struct {
+	pthread_t thr;
+	de_thread_fn_type fn;
+	void *userdata;
+};
+
 void de_vsnprintf(char *buf, size_t buflen, const char *fmt, va_list ap)
 {
 	vsnprintf(buf,buflen,fmt,ap);
@@ -188,6 +198,32 @@ int de_fclose(FILE *fp)
 	return fclose(fp);
 }
 
+// Map a file that has been opened for reading into memory.
+// Returns NULL if that's not possible, in which case the caller should fall
+// back to using stdio. The returned pointer must be released with
+// de_munmap().
+const u8 *de_mmap_for_read(deark *c, FILE *fp, i64 len, void **phandle)
+{
+	void *mem;
+
+	*phandle = NULL;
+	if(len<1) return NULL;
+	if((u64)len > (u64)(size_t)(-1)) return NULL;
+
+	mem = mmap(NULL, (size_t)len, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+	if(mem==MAP_FAILED) {
+		de_dbg2(c, "mmap failed: %s", strerror(errno));
+		return NULL;
+	}
+	return (const u8*)mem;
+}
+
+void de_munmap(deark *c, const u8 *mem, i64 len, void *handle)
+{
+	if(!mem) return;
+	munmap((void*)mem, (size_t)len);
+}
+
 struct upd_attr_ctx {
 	int tried_stat;
 	int stat_ret;
@@ -305,11 +341,63 @@ void de_current_time_to_timestamp(struct de_timestamp *ts)
 	de_timestamp_set_subsec(ts, ((double)tv.tv_usec)/1000000.0);
 }
 
+// Returns a time in nanoseconds, relative to some arbitrary starting point.
+// Only useful for measuring elapsed time.
+i64 de_get_highres_time_ns(void)
+{
+	struct timespec ts;
+
+	if(clock_gettime(CLOCK_MONOTONIC, &ts)!=0) return 0;
+	return (i64)ts.tv_sec*1000000000 + (i64)ts.tv_nsec;
+}
+
 void de_exitprocess(int s)
 {
 	exit(s);
 }
 
+// Runs fn in a child process, which exits with the status that fn returns.
+// Returns the process ID of the child, or -1 on failure.
+i64 de_start_worker_process(de_worker_fn_type fn, void *userdata)
+{
+	pid_t pid;
+
+	// Don't let the child inherit any buffered output.
+	fflush(stdout);
+	fflush(stderr);
+
+	pid = fork();
+	if(pid<0) return -1;
+	if(pid==0) {
+		int s;
+
+		s = fn(userdata);
+		fflush(stdout);
+		fflush(stderr);
+		_exit(s);
+	}
+	return (i64)pid;
+}
+
+// Waits for any worker process to finish.
+// Returns its process ID, or -1 if there are no more workers.
+i64 de_wait_for_worker_process(int *pexit_status)
+{
+	pid_t pid;
+	int wstatus = 0;
+
+	do {
+		pid = waitpid(-1, &wstatus, 0);
+	} while(pid<0 && errno==EINTR);
+	if(pid<0) return -1;
+
+	if(WIFEXITED(wstatus))
+		*pexit_status = WEXITSTATUS(wstatus);
+	else
+		*pexit_status = 1; // killed by a signal, etc.
+	return (i64)pid;
+}
+
 struct de_platform_data *de_platformdata_create(void)
 {
 	struct de_platform_data *plctx;
@@ -324,4 +412,36 @@ void de_platformdata_destroy(struct de_platform_data *plctx)
 	de_free(NULL, plctx);
 }
 
+static void *thread_start_routine(void *arg)
+{
+	de_thread *t = (de_thread*)arg;
+
+	t->fn(t->userdata);
+	return NULL;
+}
+
+// Returns NULL if the thread could not be started. In that case, the caller
+// should call fn itself.
+de_thread *de_thread_create(deark *c, de_thread_fn_type fn, void *userdata)
+{
+	de_thread *t;
+
+	t = de_malloc(c, sizeof(de_thread));
+	t->fn = fn;
+	t->userdata = userdata;
+	if(pthread_create(&t->thr, NULL, thread_start_routine, (void*)t) != 0) {
+		de_free(c, t);
+		return NULL;
+	}
+	return t;
+}
+
+// Waits for the thread to finish, and frees t.
+void de_thread_join(deark *c, de_thread *t)
+{
+	if(!t) return;
+	pthread_join(t->thr, NULL);
+	de_free(c, t);
+}
+
 #endif // DE_UNIX
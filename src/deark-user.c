@@ -14,8 +14,219 @@
 
 #define DE_DEFAULT_MAX_FILE_SIZE 0x280000000LL // 10GiB
 #define DE_DEFAULT_MAX_TOTAL_OUTPUT_SIZE 0x3c0000000LL // 15GiB
+#define DE_DEFAULT_RECURSE_MAX_DEPTH 5
+#define DE_DEFAULT_RECURSE_MAX_TOTAL_SIZE 0x40000000LL // 1GiB
 #define DE_DEFAULT_MAX_IMAGE_DIMENSION 10000
 
+struct de_sig_index_entry {
+	int module_idx;
+	const struct deark_module_sig *sig;
+};
+
+// An index of the modules' signature tables, so that we only have to test
+// the signatures that could possibly match.
+struct de_detection_index {
+	// Signatures at offset 0, sorted by their first byte.
+	// Those starting with byte b are entries[bucket_start[b]] through
+	// entries[bucket_start[b+1]-1].
+	struct de_sig_index_entry *entries;
+	size_t bucket_start[257];
+
+	// Signatures at other offsets, which are always tested.
+	struct de_sig_index_entry *other_entries;
+	size_t num_other_entries;
+
+	// For the current file: the best confidence of the module's matching
+	// signatures, or -1 if none matched.
+	int *sig_confidence;
+};
+
+static void build_detection_index(deark *c)
+{
+	struct de_detection_index *idx;
+	size_t num_pos0 = 0;
+	size_t bucket_count[256];
+	size_t k;
+	int i;
+
+	idx = de_malloc(c, sizeof(struct de_detection_index));
+	c->detection_index = idx;
+	idx->sig_confidence = de_mallocarray(c, c->num_modules, sizeof(int));
+	de_zeromem(bucket_count, sizeof(bucket_count));
+
+	for(i=0; i<c->num_modules; i++) {
+		for(k=0; k<c->module_info[i].num_sigs; k++) {
+			const struct deark_module_sig *sig = &c->module_info[i].sigs[k];
+
+			if(sig->pos==0 && sig->len>0) {
+				bucket_count[(u8)sig->sig[0]]++;
+				num_pos0++;
+			}
+			else {
+				idx->num_other_entries++;
+			}
+		}
+	}
+
+	idx->bucket_start[0] = 0;
+	for(k=0; k<256; k++) {
+		idx->bucket_start[k+1] = idx->bucket_start[k] + bucket_count[k];
+	}
+
+	idx->entries = de_mallocarray(c, (i64)num_pos0, sizeof(struct de_sig_index_entry));
+	idx->other_entries = de_mallocarray(c, (i64)idx->num_other_entries,
+		sizeof(struct de_sig_index_entry));
+
+	// Fill in the entries. Reuse bucket_count[] as the number of entries
+	// filled in so far, so that each bucket stays in module order.
+	de_zeromem(bucket_count, sizeof(bucket_count));
+	idx->num_other_entries = 0;
+	for(i=0; i<c->num_modules; i++) {
+		for(k=0; k<c->module_info[i].num_sigs; k++) {
+			const struct deark_module_sig *sig = &c->module_info[i].sigs[k];
+			struct de_sig_index_entry *e;
+
+			if(sig->pos==0 && sig->len>0) {
+				u8 b = (u8)sig->sig[0];
+
+				e = &idx->entries[idx->bucket_start[b] + bucket_count[b]];
+				bucket_count[b]++;
+			}
+			else {
+				e = &idx->other_entries[idx->num_other_entries];
+				idx->num_other_entries++;
+			}
+			e->module_idx = i;
+			e->sig = sig;
+		}
+	}
+}
+
+static void destroy_detection_index(deark *c)
+{
+	if(!c->detection_index) return;
+	de_free(c, c->detection_index->entries);
+	de_free(c, c->detection_index->other_entries);
+	de_free(c, c->detection_index->sig_confidence);
+	de_free(c, c->detection_index);
+	c->detection_index = NULL;
+}
+
+static void test_sig_index_entry(deark *c, const struct de_sig_index_entry *e)
+{
+	int *pconf = &c->detection_index->sig_confidence[e->module_idx];
+
+	if(e->sig->confidence <= *pconf) return;
+	if(dbuf_memcmp(c->infile, e->sig->pos, e->sig->sig, e->sig->len)) return;
+	*pconf = e->sig->confidence;
+}
+
+// Set up detection_index->sig_confidence[] for the current input file.
+static void match_signatures(deark *c)
+{
+	struct de_detection_index *idx;
+	size_t k;
+	int i;
+	u8 b;
+
+	if(!c->detection_index) {
+		build_detection_index(c);
+	}
+	idx = c->detection_index;
+
+	for(i=0; i<c->num_modules; i++) {
+		idx->sig_confidence[i] = -1;
+	}
+
+	b = dbuf_getbyte(c->infile, 0);
+	for(k=idx->bucket_start[b]; k<idx->bucket_start[b+1]; k++) {
+		test_sig_index_entry(c, &idx->entries[k]);
+	}
+	for(k=0; k<idx->num_other_entries; k++) {
+		test_sig_index_entry(c, &idx->other_entries[k]);
+	}
+}
+
+struct de_detection_profile_entry {
+	int module_idx;
+	i64 time_ns;
+	i64 bytes_read;
+	int confidence;
+};
+
+// Data collected for "-opt detect:profile".
+struct de_detection_profile {
+	u8 json;
+	i64 sigmatch_time_ns;
+	i64 total_time_ns;
+	int num_entries;
+	struct de_detection_profile_entry *entries; // array[num_modules]
+};
+
+static void create_detection_profile(deark *c, const char *optval)
+{
+	c->detection_profile = de_malloc(c, sizeof(struct de_detection_profile));
+	c->detection_profile->json = !de_strcmp(optval, "json");
+	c->detection_profile->entries = de_mallocarray(c, c->num_modules,
+		sizeof(struct de_detection_profile_entry));
+}
+
+static void destroy_detection_profile(deark *c)
+{
+	if(!c->detection_profile) return;
+	de_free(c, c->detection_profile->entries);
+	de_free(c, c->detection_profile);
+	c->detection_profile = NULL;
+}
+
+// Sort by time, slowest first.
+static int profile_entry_compare_fn(const void *a, const void *b)
+{
+	const struct de_detection_profile_entry *e1, *e2;
+
+	e1 = (const struct de_detection_profile_entry *)a;
+	e2 = (const struct de_detection_profile_entry *)b;
+	if(e1->time_ns > e2->time_ns) return -1;
+	if(e1->time_ns < e2->time_ns) return 1;
+	return e1->module_idx - e2->module_idx;
+}
+
+static void print_detection_profile(deark *c)
+{
+	struct de_detection_profile *prof = c->detection_profile;
+	int k;
+
+	qsort((void*)prof->entries, (size_t)prof->num_entries,
+		sizeof(struct de_detection_profile_entry), profile_entry_compare_fn);
+
+	if(prof->json) {
+		de_msg(c, "{\"total_us\":%.3f,\"signatures_us\":%.3f,\"modules\":[",
+			(double)prof->total_time_ns/1000.0, (double)prof->sigmatch_time_ns/1000.0);
+		for(k=0; k<prof->num_entries; k++) {
+			const struct de_detection_profile_entry *e = &prof->entries[k];
+
+			de_msg(c, "{\"module\":\"%s\",\"us\":%.3f,\"bytes\":%"I64_FMT
+				",\"confidence\":%d}%s",
+				c->module_info[e->module_idx].id, (double)e->time_ns/1000.0,
+				e->bytes_read, e->confidence, (k+1<prof->num_entries)?",":"");
+		}
+		de_msg(c, "]}");
+		return;
+	}
+
+	de_msg(c, "Detection profile: %d identify functions, %.3f ms total "
+		"(signature matching: %.3f ms)", prof->num_entries,
+		(double)prof->total_time_ns/1000000.0,
+		(double)prof->sigmatch_time_ns/1000000.0);
+	de_msg(c, "%12s %10s %6s  %s", "time(us)", "bytes", "conf", "module");
+	for(k=0; k<prof->num_entries; k++) {
+		const struct de_detection_profile_entry *e = &prof->entries[k];
+
+		de_msg(c, "%12.3f %10"I64_FMT" %6d  %s", (double)e->time_ns/1000.0,
+			e->bytes_read, e->confidence, c->module_info[e->module_idx].id);
+	}
+}
+
 // Returns the best module to use, by looking at the file contents, etc.
 static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
 {
@@ -23,8 +234,22 @@ static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
 	int result;
 	int orig_errcount;
 	struct deark_module_info *best_module = NULL;
+	struct de_detection_profile *prof = NULL;
+	const char *s;
+	i64 start_time = 0;
+	i64 t0 = 0;
+	i64 nbytes0 = 0;
 
 	*errflag = 0;
+
+	s = de_get_ext_option(c, "detect:profile");
+	if(s) {
+		destroy_detection_profile(c);
+		create_detection_profile(c, s);
+		prof = c->detection_profile;
+		start_time = de_get_highres_time_ns();
+	}
+
 	if(!c->detection_data) {
 		c->detection_data = de_malloc(c, sizeof(struct de_detection_data_struct));
 	}
@@ -39,9 +264,16 @@ static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
 		c->detection_data->has_utf8_bom = 1;
 	}
 
+	match_signatures(c);
+	if(prof) {
+		prof->sigmatch_time_ns = de_get_highres_time_ns() - start_time;
+	}
+
 	orig_errcount = c->error_count;
 	for(i=0; i<c->num_modules; i++) {
-		if(c->module_info[i].identify_fn==NULL) continue;
+		if(c->module_info[i].identify_fn==NULL && c->module_info[i].sigs==NULL) {
+			continue;
+		}
 
 		// If autodetect is disabled for this module, and its autodetect routine
 		// doesn't do anything that may be needed by other modules, don't bother
@@ -52,7 +284,34 @@ static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
 			continue;
 		}
 
-		result = c->module_info[i].identify_fn(c);
+		if(prof && c->module_info[i].identify_fn) {
+			t0 = de_get_highres_time_ns();
+			nbytes0 = c->infile->num_bytes_read;
+		}
+
+		if(c->module_info[i].sigs) {
+			// If none of the module's signatures match, it can't be this format.
+			if(c->detection_index->sig_confidence[i]<0) continue;
+
+			if(c->module_info[i].identify_fn) {
+				result = c->module_info[i].identify_fn(c);
+			}
+			else {
+				result = c->detection_index->sig_confidence[i];
+			}
+		}
+		else {
+			result = c->module_info[i].identify_fn(c);
+		}
+
+		if(prof && c->module_info[i].identify_fn) {
+			struct de_detection_profile_entry *e = &prof->entries[prof->num_entries++];
+
+			e->module_idx = i;
+			e->time_ns = de_get_highres_time_ns() - t0;
+			e->bytes_read = c->infile->num_bytes_read - nbytes0;
+			e->confidence = result;
+		}
 
 		if(c->error_count > orig_errcount) {
 			// Detection routines don't normally produce errors. If one does,
@@ -74,6 +333,9 @@ static struct deark_module_info *detect_module_for_file(deark *c, int *errflag)
 		if(c->detection_data->best_confidence_so_far>=100) break;
 	}
 
+	if(prof) {
+		prof->total_time_ns = de_get_highres_time_ns() - start_time;
+	}
 	return best_module;
 }
 
@@ -210,7 +472,139 @@ static void open_extrlist(deark *c)
 		DE_OVERWRITEMODE_STANDARD, flags);
 }
 
+// Called by dbuf_close() in recursive mode, when an output file that is being
+// held in memory is complete. Treats the file as if it were an input file:
+// If its format is detected, the module is run, and any files found inside
+// it are written, named after it.
+// Returns 1 if the file itself should still be written, or 0 if it is just an
+// intermediate file that we no longer need.
+int de_recurse_into_output_file(deark *c, dbuf *f)
+{
+	struct deark_module_info *mi;
+	struct de_detection_data_struct detection_data;
+	struct de_detection_data_struct *old_detection_data;
+	struct de_detection_profile *old_detection_profile;
+	dbuf *old_infile;
+	const char *old_input_filename;
+	char *old_base_output_filename;
+	int old_file_count;
+	int old_first_output_file;
+	int old_max_output_files;
+	int old_num_main_files_created;
+	int old_format_declared;
+	int old_suppress_detection_by_filename;
+	int errflag = 0;
+	int keep = 1;
+
+	if(f->len > c->recurse_budget) return 1;
+	c->recurse_budget -= f->len;
+
+	old_infile = c->infile;
+	old_input_filename = c->input_filename;
+	old_base_output_filename = c->base_output_filename;
+	old_file_count = c->file_count;
+	old_first_output_file = c->first_output_file;
+	old_max_output_files = c->max_output_files;
+	old_num_main_files_created = c->num_main_files_created;
+	old_format_declared = c->format_declared;
+	old_suppress_detection_by_filename = c->suppress_detection_by_filename;
+	old_detection_data = c->detection_data;
+	old_detection_profile = c->detection_profile;
+
+	// Files found inside f are named "<f's name>.000.<ext>", etc.
+	// The -firstfile and -maxfiles options only apply to the top-level files.
+	c->infile = f;
+	c->input_filename = f->name;
+	c->base_output_filename = f->name;
+	c->file_count = 0;
+	c->first_output_file = 0;
+	c->max_output_files = -1;
+	c->num_main_files_created = 0;
+	c->format_declared = 0;
+	c->suppress_detection_by_filename = 0;
+	de_zeromem(&detection_data, sizeof(struct de_detection_data_struct));
+	c->detection_data = &detection_data;
+	c->detection_profile = NULL;
+
+	mi = detect_module_for_file(c, &errflag);
+	if(c->detection_profile) {
+		print_detection_profile(c);
+		destroy_detection_profile(c);
+	}
+
+	if(errflag || !mi) goto done;
+	// Modules that are not expected to extract anything aren't worth running.
+	if(mi->unique_id==1 || (mi->flags & (DE_MODFLAG_NOEXTRACT|DE_MODFLAG_SECURITYWARNING))) {
+		goto done;
+	}
+
+	de_info(c, "Processing %s (module: %s)", f->name, mi->id);
+	c->recurse_depth++;
+	de_run_module(c, mi, NULL, DE_MODDISP_AUTODETECT);
+	c->recurse_depth--;
+
+	// With recurse:keep=0, if we found any "main" files inside it, we
+	// consider it to have been fully converted, and don't write it. (If we
+	// only found e.g. a thumbnail image, keep it.)
+	if(c->num_main_files_created>0 && !c->recurse_keep_all) {
+		keep = 0;
+	}
+
+done:
+	c->infile = old_infile;
+	c->input_filename = old_input_filename;
+	c->base_output_filename = old_base_output_filename;
+	c->file_count = old_file_count;
+	c->first_output_file = old_first_output_file;
+	c->max_output_files = old_max_output_files;
+	c->num_main_files_created = old_num_main_files_created;
+	c->format_declared = old_format_declared;
+	c->suppress_detection_by_filename = old_suppress_detection_by_filename;
+	c->detection_data = old_detection_data;
+	c->detection_profile = old_detection_profile;
+	return keep;
+}
+
+// Optional. Call this before the first de_run() when processing more than one
+// input file, possibly in worker processes. It does the setup work that can
+// be shared by all the runs, and opens files that all runs write to.
+void de_prepare_batch(deark *c)
+{
+	de_register_modules(c);
+	if(!c->detection_index) {
+		build_detection_index(c);
+	}
+	if(c->extrlist_filename) {
+		open_extrlist(c);
+	}
+	if(c->extrlist_dbuf) {
+		// Make sure no buffered data gets duplicated in worker processes.
+		dbuf_flush(c->extrlist_dbuf);
+	}
+}
+
+// Reset the fields that describe the current input file, so that de_run()
+// can be called more than once with the same deark object.
+static void reset_per_input_state(deark *c)
+{
+	c->infile = NULL;
+	c->format_declared = 0;
+	c->file_count = 0;
+	c->num_files_extracted = 0;
+	c->total_output_size = 0;
+	c->num_main_files_created = 0;
+	c->recurse_depth = 0;
+	c->error_count = 0;
+	c->serious_error_flag = 0;
+	c->suppress_detection_by_filename = 0;
+	if(c->detection_data) {
+		de_zeromem(c->detection_data, sizeof(struct de_detection_data_struct));
+	}
+}
+
 // Returns 0 on "serious" error; e.g. input file not found.
+// May be called multiple times (e.g. once per input file, in batch mode),
+// after changing the input filename and base output filename.
 int de_run(deark *c)
 {
 	dbuf *orig_ifile = NULL;
@@ -224,6 +618,8 @@ int de_run(deark *c)
 	de_module_params *mparams = NULL;
 	de_ucstring *friendly_infn = NULL;
 
+	reset_per_input_state(c);
+
 	if(c->modhelp_req && c->input_format_req) {
 		do_modhelp(c);
 		goto done;
@@ -408,9 +804,28 @@ int de_run(deark *c)
 		}
 	}
 
+	if(de_get_ext_option_bool(c, "recurse", 0)) {
+		const char *s_opt;
+
+		c->recurse_max_depth = DE_DEFAULT_RECURSE_MAX_DEPTH;
+		s_opt = de_get_ext_option(c, "recurse:maxdepth");
+		if(s_opt) {
+			c->recurse_max_depth = de_atoi(s_opt);
+		}
+		c->recurse_budget = DE_DEFAULT_RECURSE_MAX_TOTAL_SIZE;
+		s_opt = de_get_ext_option(c, "recurse:maxtotalsize");
+		if(s_opt) {
+			c->recurse_budget = de_atoi64(s_opt);
+		}
+		c->recurse_keep_all = (u8)de_get_ext_option_bool(c, "recurse:keep", 1);
+	}
+
 	if(de_get_ext_option_bool(c, "list:fileid", 0)) {
 		c->list_mode_include_file_id = 1;
 	}
+	if(de_get_ext_option_bool(c, "list:size", 0)) {
+		c->list_mode_include_size = 1;
+	}
 
 	if(c->modcodes_req) {
 		if(!mparams)
@@ -442,7 +857,12 @@ int de_run(deark *c)
 	}
 
 done:
-	if(c->extrlist_dbuf) { dbuf_close(c->extrlist_dbuf); c->extrlist_dbuf=NULL; }
+	if(c->detection_profile) {
+		print_detection_profile(c);
+		destroy_detection_profile(c);
+	}
+	// Note: c->extrlist_dbuf is left open, in case there is another input
+	// file. It is closed by de_destroy().
 	ucstring_destroy(friendly_infn);
 	if(subfile) dbuf_close(subfile);
 	if(orig_ifile) dbuf_close(orig_ifile);
@@ -450,9 +870,59 @@ done:
 	return c->serious_error_flag ? 0 : 1;
 }
 
+// Read a list of filenames from the file fn (or from stdin, if fn is NULL),
+// one per line, and call cbfn for each. Blank lines are ignored, as is a
+// UTF-8 BOM.
+// Returns 0 if the list could not be read.
+int de_read_filename_list(deark *c, const char *fn, de_filename_list_cbfn cbfn,
+	void *userdata)
+{
+	dbuf *f = NULL;
+	char *namebuf = NULL;
+	i64 pos = 0;
+	int retval = 0;
+
+	if(fn)
+		f = dbuf_open_input_file(c, fn);
+	else
+		f = dbuf_open_input_stdin(c);
+	if(!f) goto done;
+
+	if(!dbuf_memcmp(f, 0, "\xef\xbb\xbf", 3)) {
+		pos = 3;
+	}
+
+	while(pos < f->len) {
+		i64 content_len, total_len;
+
+		if(!dbuf_find_line(f, pos, &content_len, &total_len)) {
+			// Last line, with no terminator
+			content_len = f->len - pos;
+			total_len = content_len;
+		}
+
+		if(content_len>0) {
+			namebuf = de_malloc(c, content_len+1);
+			dbuf_read(f, (u8*)namebuf, pos, content_len);
+			cbfn(c, userdata, namebuf);
+			de_free(c, namebuf);
+			namebuf = NULL;
+		}
+		pos += total_len;
+	}
+	retval = 1;
+
+done:
+	dbuf_close(f);
+	de_free(c, namebuf);
+	return retval;
+}
+
 deark *de_create_internal(void)
 {
 	deark *c;
+
+	de_crc_init_tables();
 	c = de_malloc(NULL,sizeof(deark));
 	c->show_infomessages = 1;
 	c->show_warnings = 1;
@@ -489,6 +959,8 @@ void de_destroy(deark *c)
 	if(c->output_archive_filename) { de_free(c, c->output_archive_filename); }
 	if(c->extrlist_filename) { de_free(c, c->extrlist_filename); }
 	if(c->detection_data) { de_free(c, c->detection_data); }
+	destroy_detection_index(c);
+	destroy_detection_profile(c);
 	de_free(c, c->module_info);
 	de_free(NULL,c);
 }
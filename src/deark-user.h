@@ -23,8 +23,13 @@ void de_set_input_timezone(deark *c, i64 tzoffs_seconds);
 void de_set_input_file_slice_start(deark *c, i64 n);
 void de_set_input_file_slice_size(deark *c, i64 n);
 
+void de_prepare_batch(deark *c);
 int de_run(deark *c);
 
+typedef void (*de_filename_list_cbfn)(deark *c, void *userdata, const char *fn);
+int de_read_filename_list(deark *c, const char *fn, de_filename_list_cbfn cbfn,
+	void *userdata);
+
 void de_print_module_list(deark *c);
 
 void de_set_userdata(deark *c, void *x);
@@ -97,6 +102,13 @@ struct de_platform_data;
 struct de_platform_data *de_platformdata_create(void);
 void de_platformdata_destroy(struct de_platform_data *plctx);
 
+// Worker processes, used by the parallel batch mode.
+// de_start_worker_process() returns -1 if it failed, or if worker processes
+// are not supported on this platform.
+typedef int (*de_worker_fn_type)(void *userdata);
+i64 de_start_worker_process(de_worker_fn_type fn, void *userdata);
+i64 de_wait_for_worker_process(int *pexit_status);
+
 #ifdef DE_WINDOWS
 void de_utf8_to_oem(deark *c, const char *src, char *dst, size_t dstlen);
 char **de_convert_args_to_utf8(int argc, wchar_t **argvW);
@@ -729,6 +729,68 @@ void de_free(deark *c, void *m)
 	free(m);
 }
 
+struct jobrunner_ctx {
+	de_thread_fn_type fn;
+	void **jobs;
+	i64 num_jobs;
+	i64 first_job;
+	i64 job_step;
+};
+
+static void jobrunner_fn(void *userdata)
+{
+	struct jobrunner_ctx *jr = (struct jobrunner_ctx*)userdata;
+	i64 i;
+
+	for(i=jr->first_job; i<jr->num_jobs; i+=jr->job_step) {
+		jr->fn(jr->jobs[i]);
+	}
+}
+
+// Calls fn(jobs[i]) for each job, dividing them among up to max_threads
+// threads (one of which is the calling thread). Returns when all jobs are
+// finished. If threads are not available, the jobs are run one at a time.
+// The jobs must not use anything that isn't thread-safe. In particular, they
+// should not print messages, except in the case of an internal error.
+void de_run_jobs_in_parallel(deark *c, de_thread_fn_type fn, void **jobs,
+	i64 num_jobs, int max_threads)
+{
+	struct jobrunner_ctx *jr;
+	de_thread **thr;
+	i64 num_threads;
+	i64 i;
+
+	if(num_jobs<1) return;
+	num_threads = de_min_int(num_jobs, (i64)max_threads);
+	if(num_threads<1) num_threads = 1;
+
+	jr = de_mallocarray(c, num_threads, sizeof(struct jobrunner_ctx));
+	thr = de_mallocarray(c, num_threads, sizeof(de_thread*));
+
+	for(i=0; i<num_threads; i++) {
+		jr[i].fn = fn;
+		jr[i].jobs = jobs;
+		jr[i].num_jobs = num_jobs;
+		jr[i].first_job = i;
+		jr[i].job_step = num_threads;
+	}
+
+	for(i=1; i<num_threads; i++) {
+		thr[i] = de_thread_create(c, jobrunner_fn, (void*)&jr[i]);
+		if(!thr[i]) {
+			jobrunner_fn((void*)&jr[i]);
+		}
+	}
+
+	jobrunner_fn((void*)&jr[0]);
+
+	for(i=1; i<num_threads; i++) {
+		de_thread_join(c, thr[i]);
+	}
+	de_free(c, thr);
+	de_free(c, jr);
+}
+
 // Returns the index into c->module_info[], or -1 if no found.
 int de_get_module_idx_by_id(deark *c, const char *module_id)
 {
@@ -1787,105 +1849,482 @@ struct de_crcobj {
 	u32 val;
 	unsigned int crctype;
 	deark *c;
-	u16 *table16;
+	const u16 *table16;
+	const u32 *table32; // For CRC-32: 8 tables of 256 entries each
+	u8 use_hw_crc32;
 };
 
+// The lookup tables are shared by all crcobjs. They are built once, by
+// de_crc_init_tables(), and are read-only after that.
+static u32 crc32_table[8*256];
+static u16 crc16ccitt_table[8*256];
+static u16 crc16arc_table[8*256];
+static u8 crc32_hw_ok;
+static u8 crc_tables_initialized;
+
 #define DE_CRC32_INIT 0
 
-// crc32_calc() is based on public domain code by Jon Mayo, downloaded
-// from <http://orangetide.com/code/crc.c>.
-// It includes minor changes for Deark. I disclaim any copyright on these
-// minor changes. -JS
-// Note: I have found several other seemingly-independent implementations
-// of the same algorithm, such as the one by Karl Malbrain, used in miniz.
-// I don't know its origin.
-static u32 crc32_calc(const u8 *ptr, size_t cnt, u32 crc)
-{
-	static const u32 crc32_tab[16] = {
-		0x00000000U, 0x1db71064U, 0x3b6e20c8U, 0x26d930acU,
-		0x76dc4190U, 0x6b6b51f4U, 0x4db26158U, 0x5005713cU,
-		0xedb88320U, 0xf00f9344U, 0xd6d6a3e8U, 0xcb61b38cU,
-		0x9b64c2b0U, 0x86d3d2d4U, 0xa00ae278U, 0xbdbdf21cU
-	};
+// CRC-32 (as used by ZIP, PNG, gzip, etc.) is computed using the
+// "slice-by-8" algorithm, which processes 8 bytes at a time with 8 lookup
+// tables. table32[0..255] is the usual byte-at-a-time table, and each
+// subsequent table extends the previous one by one zero byte.
+// If the CPU supports it, a faster hardware-accelerated method is used
+// for large buffers instead.
+static void de_crc32_init_table(void)
+{
+	u32 i, k;
+	u32 *t = crc32_table;
+
+	for(i=0; i<256; i++) {
+		u32 x = i;
+
+		for(k=0; k<8; k++) {
+			x = (x>>1) ^ ((x & 1) ? 0xedb88320U : 0);
+		}
+		t[i] = x;
+	}
+	for(k=1; k<8; k++) {
+		for(i=0; i<256; i++) {
+			u32 x = t[(k-1)*256+i];
+
+			t[k*256+i] = (x>>8) ^ t[x & 0xff];
+		}
+	}
+}
 
-	if(cnt==0) return crc;
-	crc = ~crc;
+// crc is the internal (bit-inverted) CRC register.
+static u32 crc32_calc_sw(const u32 *t, const u8 *p, size_t cnt, u32 crc)
+{
+	while(cnt>=8) {
+		crc ^= (u32)p[0] | ((u32)p[1]<<8) | ((u32)p[2]<<16) | ((u32)p[3]<<24);
+		crc = t[7*256 + (crc & 0xff)] ^
+			t[6*256 + ((crc>>8) & 0xff)] ^
+			t[5*256 + ((crc>>16) & 0xff)] ^
+			t[4*256 + (crc>>24)] ^
+			t[3*256 + p[4]] ^
+			t[2*256 + p[5]] ^
+			t[1*256 + p[6]] ^
+			t[p[7]];
+		p += 8;
+		cnt -= 8;
+	}
 	while(cnt--) {
-		crc = (crc >> 4) ^ crc32_tab[(crc & 0xf) ^ (*ptr & 0xf)];
-		crc = (crc >> 4) ^ crc32_tab[(crc & 0xf) ^ (*ptr++ >> 4)];
+		crc = (crc>>8) ^ t[(crc ^ *p++) & 0xff];
+	}
+	return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define DE_CRC32_HW_PCLMUL
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#define DE_CRC32_HW_ARM
+#include <arm_acle.h>
+#endif
+
+// Only use the hardware method for buffers at least this large.
+#define DE_CRC32_HW_MIN_LEN 64
+
+#ifdef DE_CRC32_HW_PCLMUL
+
+// CRC-32 using carry-less multiplication (the PCLMULQDQ instruction), based
+// on the method in Intel's "Fast CRC Computation for Generic Polynomials
+// Using PCLMULQDQ Instruction" paper. This is the same method used by
+// Chromium's zlib and others.
+// len must be at least 64, and a multiple of 16.
+// crc is the internal (bit-inverted) CRC register.
+__attribute__((target("pclmul,sse2")))
+static u32 crc32_calc_pclmul(const u8 *buf, size_t len, u32 crc)
+{
+	static const u64 k1k2[2] __attribute__((aligned(16))) =
+		{ 0x0154442bd4ULL, 0x01c6e41596ULL };
+	static const u64 k3k4[2] __attribute__((aligned(16))) =
+		{ 0x01751997d0ULL, 0x00ccaa009eULL };
+	static const u64 k5k0[2] __attribute__((aligned(16))) =
+		{ 0x0163cd6124ULL, 0x0000000000ULL };
+	static const u64 poly[2] __attribute__((aligned(16))) =
+		{ 0x01db710641ULL, 0x01f7011641ULL };
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+	x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+	x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+	x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	x0 = _mm_load_si128((const __m128i*)k1k2);
+	buf += 64;
+	len -= 64;
+
+	// Fold 64 bytes at a time
+	while(len >= 64) {
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+		y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+		y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+		y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+		y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+		buf += 64;
+		len -= 64;
+	}
+
+	// Fold the four 128-bit values into one
+	x0 = _mm_load_si128((const __m128i*)k3k4);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	// Fold 16 bytes at a time
+	while(len >= 16) {
+		x2 = _mm_loadu_si128((const __m128i*)buf);
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+		buf += 16;
+		len -= 16;
+	}
+
+	// Fold 128 bits to 64 bits
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+	x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32 bits
+	x0 = _mm_load_si128((const __m128i*)poly);
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (u32)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+static int crc32_hw_available(void)
+{
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+}
+
+#endif // DE_CRC32_HW_PCLMUL
+
+#ifdef DE_CRC32_HW_ARM
+
+// CRC-32 using the ARMv8 CRC32 instructions.
+// This is only compiled if the target is known to support them.
+static u32 crc32_calc_arm(const u8 *p, size_t cnt, u32 crc)
+{
+	while(cnt>=8) {
+		u64 x = (u64)p[0] | ((u64)p[1]<<8) | ((u64)p[2]<<16) | ((u64)p[3]<<24) |
+			((u64)p[4]<<32) | ((u64)p[5]<<40) | ((u64)p[6]<<48) | ((u64)p[7]<<56);
+
+		crc = __crc32d(crc, x);
+		p += 8;
+		cnt -= 8;
 	}
-	return ~crc;
+	while(cnt--) {
+		crc = __crc32b(crc, *p++);
+	}
+	return crc;
 }
 
-// For a one-shot CRC calculations, or the first part of a multi-part
-// calculation.
-// buf can be NULL (in which case buf_len should be 0, but is ignored)
-static u32 de_crc32(const void *buf, i64 buf_len)
+static int crc32_hw_available(void)
 {
-	if(!buf) return DE_CRC32_INIT;
-	return (u32)crc32_calc((const u8*)buf, (size_t)buf_len, DE_CRC32_INIT);
+	return 1;
 }
 
-static u32 de_crc32_continue(u32 prev_crc, const void *buf, i64 buf_len)
+#endif // DE_CRC32_HW_ARM
+
+static u32 de_crc32_continue(struct de_crcobj *crco, u32 prev_crc,
+	const u8 *buf, i64 buf_len)
 {
-	return (u32)crc32_calc((const u8*)buf, (size_t)buf_len, prev_crc);
+	u32 crc;
+	size_t cnt = (size_t)buf_len;
+
+	if(buf_len<=0) return prev_crc;
+	crc = ~prev_crc;
+
+#ifdef DE_CRC32_HW_PCLMUL
+	if(crco->use_hw_crc32 && cnt>=DE_CRC32_HW_MIN_LEN) {
+		size_t n = cnt & ~(size_t)15;
+
+		crc = crc32_calc_pclmul(buf, n, crc);
+		buf += n;
+		cnt -= n;
+	}
+#endif
+#ifdef DE_CRC32_HW_ARM
+	if(crco->use_hw_crc32) {
+		return ~crc32_calc_arm(buf, cnt, crc);
+	}
+#endif
+
+	crc = crc32_calc_sw(crco->table32, buf, cnt, crc);
+	return ~crc;
 }
 
+// The CRC-16 algorithms also use the slice-by-8 method. table16 holds 8
+// tables of 256 entries each.
+
 // This is the CRC-16 algorithm used in MacBinary.
 // It is in the x^16 + x^12 + x^5 + 1 family.
 // CRC-16-CCITT is probably the best name for it, though I'm not completely
 // sure, and there are several algorithms that have been called "CRC-16-CCITT".
-static void de_crc16ccitt_init(struct de_crcobj *crco)
+// Unlike the others, it processes bits most-significant first.
+static void de_crc16ccitt_init_table(void)
 {
-	const unsigned int polynomial = 0x1021;
-	unsigned int index;
+	u32 i, k;
+	u16 *t = crc16ccitt_table;
+
+	for(i=0; i<256; i++) {
+		u32 x = i<<8;
+
+		for(k=0; k<8; k++) {
+			x = ((x<<1) ^ ((x & 0x8000) ? 0x1021 : 0)) & 0xffff;
+		}
+		t[i] = (u16)x;
+	}
+	for(k=1; k<8; k++) {
+		for(i=0; i<256; i++) {
+			u32 x = t[(k-1)*256+i];
 
-	crco->table16 = de_mallocarray(crco->c, 256, sizeof(u16));
-	crco->table16[0] = 0;
-	for(index=0; index<128; index++) {
-		unsigned int carry = crco->table16[index] & 0x8000;
-		unsigned int temp = (crco->table16[index] << 1) & 0xffff;
-		crco->table16[index * 2 + (carry ? 0 : 1)] = temp ^ polynomial;
-		crco->table16[index * 2 + (carry ? 1 : 0)] = temp;
+			t[k*256+i] = (u16)(((x<<8) & 0xffff) ^ t[x>>8]);
+		}
 	}
 }
 
-static void de_crc16ccitt_continue(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
+static void de_crc16ccitt_continue(struct de_crcobj *crco, const u8 *p, i64 buf_len)
 {
-	i64 k;
+	const u16 *t = crco->table16;
+	u32 crc = crco->val;
 
-	if(!crco->table16) return;
-	for(k=0; k<buf_len; k++) {
-		crco->val = ((crco->val<<8)&0xffff) ^
-			(u32)crco->table16[((crco->val>>8) ^ (u32)buf[k]) & 0xff];
+	if(!t) return;
+	while(buf_len>=8) {
+		crc ^= ((u32)p[0]<<8) | (u32)p[1];
+		crc = (u32)t[7*256 + (crc>>8)] ^
+			(u32)t[6*256 + (crc & 0xff)] ^
+			(u32)t[5*256 + p[2]] ^
+			(u32)t[4*256 + p[3]] ^
+			(u32)t[3*256 + p[4]] ^
+			(u32)t[2*256 + p[5]] ^
+			(u32)t[1*256 + p[6]] ^
+			(u32)t[p[7]];
+		p += 8;
+		buf_len -= 8;
 	}
+	while(buf_len-- > 0) {
+		crc = ((crc<<8) & 0xffff) ^ (u32)t[((crc>>8) ^ (u32)*p++) & 0xff];
+	}
+	crco->val = crc;
 }
 
 // This is the CRC-16 algorithm used in ARC, LHA, ZOO, etc.
 // It is in the x^16 + x^15 + x^2 + 1 family.
 // It's some variant of CRC-16-IBM, and sometimes simply called "CRC-16". But
 // both these names are more ambiguous than I'd like, so I'm calling it "ARC".
-static void de_crc16arc_init(struct de_crcobj *crco)
+static void de_crc16arc_init_table(void)
 {
 	u32 i, k;
+	u16 *t = crc16arc_table;
 
-	crco->table16 = de_mallocarray(crco->c, 256, sizeof(u16));
 	for(i=0; i<256; i++) {
-		crco->table16[i] = i;
-		for(k=0; k<8; k++)
-			crco->table16[i] = (crco->table16[i]>>1) ^ ((crco->table16[i] & 1) ? 0xa001 : 0);
+		u32 x = i;
+
+		for(k=0; k<8; k++) {
+			x = (x>>1) ^ ((x & 1) ? 0xa001 : 0);
+		}
+		t[i] = (u16)x;
+	}
+	for(k=1; k<8; k++) {
+		for(i=0; i<256; i++) {
+			u32 x = t[(k-1)*256+i];
+
+			t[k*256+i] = (u16)((x>>8) ^ t[x & 0xff]);
+		}
 	}
 }
 
-static void de_crc16arc_continue(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
+static void de_crc16arc_continue(struct de_crcobj *crco, const u8 *p, i64 buf_len)
 {
-	i64 k;
+	const u16 *t = crco->table16;
+	u32 crc = crco->val;
+
+	if(!t) return;
+	while(buf_len>=8) {
+		crc ^= (u32)p[0] | ((u32)p[1]<<8);
+		crc = (u32)t[7*256 + (crc & 0xff)] ^
+			(u32)t[6*256 + (crc>>8)] ^
+			(u32)t[5*256 + p[2]] ^
+			(u32)t[4*256 + p[3]] ^
+			(u32)t[3*256 + p[4]] ^
+			(u32)t[2*256 + p[5]] ^
+			(u32)t[1*256 + p[6]] ^
+			(u32)t[p[7]];
+		p += 8;
+		buf_len -= 8;
+	}
+	while(buf_len-- > 0) {
+		crc = (crc>>8) ^ (u32)t[(crc ^ *p++) & 0xff];
+	}
+	crco->val = crc;
+}
+
+// Multiply polynomials a and b, modulo the CRC polynomial, using the
+// bit-reflected representation (as used by CRC-32 and CRC-16-ARC), in which
+// the highest bit is the x^0 term.
+static u32 crc_multmod_reflected(u32 a, u32 b, unsigned int width, u32 poly)
+{
+	u32 m = (u32)1 << (width-1);
+	u32 p = 0;
+
+	while(m) {
+		if(a & m) p ^= b;
+		m >>= 1;
+		b = (b & 1) ? ((b>>1) ^ poly) : (b>>1);
+	}
+	return p;
+}
+
+// Same as crc_multmod_reflected(), but in the normal representation (as
+// used by CRC-16-CCITT), in which the lowest bit is the x^0 term.
+static u32 crc_multmod_normal(u32 a, u32 b, unsigned int width, u32 poly)
+{
+	u32 topbit = (u32)1 << (width-1);
+	u32 mask = topbit | (topbit-1);
+	u32 p = 0;
+	int i;
+
+	for(i=(int)width-1; i>=0; i--) {
+		p = ((p<<1) ^ ((p & topbit) ? poly : 0)) & mask;
+		if(a & ((u32)1<<i)) p ^= b;
+	}
+	return p;
+}
+
+// Returns crc1 "shifted" by len2 zero bytes. That is, multiplies it by
+// x^(8*len2), modulo the CRC polynomial.
+static u32 crc_shift(unsigned int crctype, u32 crc1, i64 len2)
+{
+	u32 (*multmod)(u32 a, u32 b, unsigned int width, u32 poly);
+	unsigned int width;
+	u32 poly;
+	u32 xpow; // x^(8*2^n)
+	u32 result;
+
+	switch(crctype) {
+	case DE_CRCOBJ_CRC32_IEEE:
+		multmod = crc_multmod_reflected;
+		width = 32;
+		poly = 0xedb88320U;
+		xpow = (u32)1<<23; // x^8
+		break;
+	case DE_CRCOBJ_CRC16_ARC:
+		multmod = crc_multmod_reflected;
+		width = 16;
+		poly = 0xa001;
+		xpow = (u32)1<<7;
+		break;
+	case DE_CRCOBJ_CRC16_CCITT:
+		multmod = crc_multmod_normal;
+		width = 16;
+		poly = 0x1021;
+		xpow = 0x100;
+		break;
+	default:
+		return crc1;
+	}
+
+	result = crc1;
+	while(len2>0) {
+		if(len2 & 1) {
+			result = multmod(result, xpow, width, poly);
+		}
+		len2 >>= 1;
+		if(len2>0) {
+			xpow = multmod(xpow, xpow, width, poly);
+		}
+	}
+	return result;
+}
+
+// Adler-32, as used by zlib.
+#define DE_ADLER32_BASE 65521
+// The largest n such that 255n(n+1)/2 + (n+1)(BASE-1) <= 2^32-1
+#define DE_ADLER32_NMAX 5552
 
-	if(!crco->table16) return;
-	for(k=0; k<buf_len; k++) {
-		crco->val = ((crco->val>>8) ^
-			(u32)crco->table16[(crco->val ^ buf[k]) & 0xff]);
+static void de_adler32_continue(struct de_crcobj *crco, const u8 *p, i64 buf_len)
+{
+	u32 s1 = crco->val & 0xffff;
+	u32 s2 = crco->val >> 16;
+
+	while(buf_len>0) {
+		i64 n = de_min_int(buf_len, DE_ADLER32_NMAX);
+		i64 k;
+
+		for(k=0; k<n; k++) {
+			s1 += p[k];
+			s2 += s1;
+		}
+		s1 %= DE_ADLER32_BASE;
+		s2 %= DE_ADLER32_BASE;
+		p += n;
+		buf_len -= n;
 	}
+	crco->val = (s2<<16) | s1;
+}
+
+// Based on adler32_combine() from zlib.
+static u32 de_adler32_combine(u32 adler1, u32 adler2, i64 len2)
+{
+	u32 sum1, sum2;
+	u32 rem;
+
+	rem = (u32)(len2 % DE_ADLER32_BASE);
+	sum1 = adler1 & 0xffff;
+	sum2 = (u32)(((u64)rem * sum1) % DE_ADLER32_BASE);
+	sum1 += (adler2 & 0xffff) + DE_ADLER32_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + DE_ADLER32_BASE - rem;
+	if(sum1 >= DE_ADLER32_BASE) sum1 -= DE_ADLER32_BASE;
+	if(sum1 >= DE_ADLER32_BASE) sum1 -= DE_ADLER32_BASE;
+	if(sum2 >= (DE_ADLER32_BASE<<1)) sum2 -= (DE_ADLER32_BASE<<1);
+	if(sum2 >= DE_ADLER32_BASE) sum2 -= DE_ADLER32_BASE;
+	return (sum2<<16) | sum1;
+}
+
+// Build the CRC lookup tables, if they haven't been built yet.
+// This is called by de_create(), before any worker threads can exist, so
+// that the tables never have to be written while they might be in use.
+void de_crc_init_tables(void)
+{
+	if(crc_tables_initialized) return;
+	de_crc32_init_table();
+	de_crc16ccitt_init_table();
+	de_crc16arc_init_table();
+#if defined(DE_CRC32_HW_PCLMUL) || defined(DE_CRC32_HW_ARM)
+	crc32_hw_ok = (u8)crc32_hw_available();
+#endif
+	crc_tables_initialized = 1;
 }
 
 // Allocate, initializes, and resets a new object
@@ -1898,11 +2337,15 @@ struct de_crcobj *de_crcobj_create(deark *c, unsigned int flags)
 	crco->crctype = flags;
 
 	switch(crco->crctype) {
+	case DE_CRCOBJ_CRC32_IEEE:
+		crco->table32 = crc32_table;
+		crco->use_hw_crc32 = crc32_hw_ok;
+		break;
 	case DE_CRCOBJ_CRC16_CCITT:
-		de_crc16ccitt_init(crco);
+		crco->table16 = crc16ccitt_table;
 		break;
 	case DE_CRCOBJ_CRC16_ARC:
-		de_crc16arc_init(crco);
+		crco->table16 = crc16arc_table;
 		break;
 	}
 
@@ -1916,7 +2359,6 @@ void de_crcobj_destroy(struct de_crcobj *crco)
 
 	if(!crco) return;
 	c = crco->c;
-	de_free(c, crco->table16);
 	de_free(c, crco);
 }
 
@@ -1926,7 +2368,10 @@ void de_crcobj_reset(struct de_crcobj *crco)
 
 	switch(crco->crctype) {
 	case DE_CRCOBJ_CRC32_IEEE:
-		crco->val = de_crc32(NULL, 0);
+		crco->val = DE_CRC32_INIT;
+		break;
+	case DE_CRCOBJ_ADLER32:
+		crco->val = 1;
 		break;
 	}
 }
@@ -1940,7 +2385,7 @@ void de_crcobj_addbuf(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
 {
 	switch(crco->crctype) {
 	case DE_CRCOBJ_CRC32_IEEE:
-		crco->val = de_crc32_continue(crco->val, buf, buf_len);
+		crco->val = de_crc32_continue(crco, crco->val, buf, buf_len);
 		break;
 	case DE_CRCOBJ_CRC16_CCITT:
 		de_crc16ccitt_continue(crco, buf, buf_len);
@@ -1948,9 +2393,27 @@ void de_crcobj_addbuf(struct de_crcobj *crco, const u8 *buf, i64 buf_len)
 	case DE_CRCOBJ_CRC16_ARC:
 		de_crc16arc_continue(crco, buf, buf_len);
 		break;
+	case DE_CRCOBJ_ADLER32:
+		de_adler32_continue(crco, buf, buf_len);
+		break;
 	}
 }
 
+// Update crco as if a segment of data had been added to it, where crc2 is
+// the CRC of that segment by itself (computed by a crcobj of the same type,
+// starting from the reset state), and len2 is its length.
+// This makes it possible to compute the CRCs of multiple segments
+// independently, then combine them.
+void de_crcobj_combine(struct de_crcobj *crco, u32 crc2, i64 len2)
+{
+	if(len2<=0) return;
+	if(crco->crctype==DE_CRCOBJ_ADLER32) {
+		crco->val = de_adler32_combine(crco->val, crc2, len2);
+		return;
+	}
+	crco->val = crc_shift(crco->crctype, crco->val, len2) ^ crc2;
+}
+
 void de_crcobj_addbyte(struct de_crcobj *crco, u8 b)
 {
 	de_crcobj_addbuf(crco, &b, 1);
@@ -1974,6 +2437,219 @@ void de_crcobj_addslice(struct de_crcobj *crco, dbuf *f, i64 pos, i64 len)
 	dbuf_buffered_read(f, pos, len, addslice_cbfn, (void*)crco);
 }
 
+// Straightforward bit-at-a-time implementations, used as a reference by
+// de_crc_selftest().
+static u32 crc_calc_bitwise(unsigned int crctype, const u8 *p, i64 len)
+{
+	u32 crc;
+	i64 i;
+	int k;
+
+	switch(crctype) {
+	case DE_CRCOBJ_CRC32_IEEE:
+		crc = 0xffffffffU;
+		for(i=0; i<len; i++) {
+			crc ^= p[i];
+			for(k=0; k<8; k++) {
+				crc = (crc>>1) ^ ((crc & 1) ? 0xedb88320U : 0);
+			}
+		}
+		return ~crc;
+	case DE_CRCOBJ_CRC16_ARC:
+		crc = 0;
+		for(i=0; i<len; i++) {
+			crc ^= p[i];
+			for(k=0; k<8; k++) {
+				crc = (crc>>1) ^ ((crc & 1) ? 0xa001 : 0);
+			}
+		}
+		return crc;
+	case DE_CRCOBJ_CRC16_CCITT:
+		crc = 0;
+		for(i=0; i<len; i++) {
+			crc ^= (u32)p[i]<<8;
+			for(k=0; k<8; k++) {
+				crc = ((crc<<1) ^ ((crc & 0x8000) ? 0x1021 : 0)) & 0xffff;
+			}
+		}
+		return crc;
+	case DE_CRCOBJ_ADLER32:
+		{
+			u32 s1 = 1, s2 = 0;
+
+			for(i=0; i<len; i++) {
+				s1 = (s1 + p[i]) % DE_ADLER32_BASE;
+				s2 = (s2 + s1) % DE_ADLER32_BASE;
+			}
+			return (s2<<16) | s1;
+		}
+	}
+	return 0;
+}
+
+static u32 crc_selftest_calc(struct de_crcobj *crco, const u8 *p, i64 len)
+{
+	de_crcobj_reset(crco);
+	de_crcobj_addbuf(crco, p, len);
+	return crco->val;
+}
+
+// Returns the speed in MB/s.
+static double crc_selftest_benchmark(struct de_crcobj *crco, const u8 *buf,
+	i64 buf_len, i64 piece_len, int iterations)
+{
+	struct de_crcobj *crco2 = NULL;
+	i64 t0, t1;
+	int n;
+
+	if(piece_len>0) {
+		crco2 = de_crcobj_create(crco->c, crco->crctype);
+		crco2->use_hw_crc32 = crco->use_hw_crc32;
+	}
+
+	t0 = de_get_highres_time_ns();
+	for(n=0; n<iterations; n++) {
+		de_crcobj_reset(crco);
+		if(crco2) {
+			i64 pos;
+
+			// Compute the CRC of each piece independently, then combine
+			// them, as is done when compressing in parallel.
+			for(pos=0; pos<buf_len; pos+=piece_len) {
+				i64 len2 = de_min_int(piece_len, buf_len-pos);
+
+				crc_selftest_calc(crco2, &buf[pos], len2);
+				de_crcobj_combine(crco, crco2->val, len2);
+			}
+		}
+		else {
+			de_crcobj_addbuf(crco, buf, buf_len);
+		}
+	}
+	t1 = de_get_highres_time_ns() - t0;
+
+	de_crcobj_destroy(crco2);
+	if(t1<=0) return 0.0;
+	return ((double)buf_len * (double)iterations * 1000.0) / (double)t1;
+}
+
+// A self-test and benchmark of the CRC functions (and Adler-32), used by
+// the "crctest" module. Checks the software method, the hardware method if
+// available, and de_crcobj_combine(), against the bitwise reference
+// implementations.
+// Returns the number of failures.
+int de_crc_selftest(deark *c)
+{
+	static const struct {
+		unsigned int crctype;
+		const char *name;
+		u32 check; // CRC of "123456789"
+	} types[] = {
+		{ DE_CRCOBJ_CRC32_IEEE, "CRC-32-IEEE", 0xcbf43926U },
+		{ DE_CRCOBJ_CRC16_ARC, "CRC-16-IBM/ARC", 0xbb3d },
+		{ DE_CRCOBJ_CRC16_CCITT, "CRC-16-CCITT", 0x31c3 },
+		{ DE_CRCOBJ_ADLER32, "Adler-32", 0x091e01de }
+	};
+#define CRC_SELFTEST_MAXLEN 300
+#define CRC_SELFTEST_MAXOFFSET 16
+#define CRC_SELFTEST_BENCH_LEN (1024*1024)
+#define CRC_SELFTEST_BENCH_ITER 64
+	u8 *buf = NULL;
+	size_t t;
+	i64 i;
+	int nfailures = 0;
+	u32 seed = 1;
+
+	buf = de_malloc(c, CRC_SELFTEST_BENCH_LEN);
+	for(i=0; i<CRC_SELFTEST_BENCH_LEN; i++) {
+		seed = seed*1103515245U + 12345U;
+		buf[i] = (u8)(seed>>16);
+	}
+
+	for(t=0; t<DE_ARRAYCOUNT(types); t++) {
+		struct de_crcobj *crco;
+		struct de_crcobj *crco2;
+		int nmethods = 1;
+		int m;
+		i64 len, offset, split;
+		u32 x;
+
+		crco = de_crcobj_create(c, types[t].crctype);
+		crco2 = de_crcobj_create(c, types[t].crctype);
+		if(types[t].crctype==DE_CRCOBJ_CRC32_IEEE && crc32_hw_ok) {
+			nmethods = 2;
+		}
+
+		for(m=0; m<nmethods; m++) {
+			const char *mname = m ? "HW" : "SW";
+			int nfailures_prev = nfailures;
+
+			crco->use_hw_crc32 = (u8)m;
+			crco2->use_hw_crc32 = (u8)m;
+
+			x = crc_selftest_calc(crco, (const u8*)"123456789", 9);
+			if(x != types[t].check) {
+				de_err(c, "%s %s: check value is 0x%08x, should be 0x%08x",
+					types[t].name, mname, (UI)x, (UI)types[t].check);
+				nfailures++;
+			}
+
+			for(offset=0; offset<CRC_SELFTEST_MAXOFFSET; offset++) {
+				for(len=0; len<=CRC_SELFTEST_MAXLEN; len++) {
+					const u8 *p = &buf[offset];
+					u32 expected;
+
+					expected = crc_calc_bitwise(types[t].crctype, p, len);
+					x = crc_selftest_calc(crco, p, len);
+					if(x != expected) {
+						de_err(c, "%s %s: offset %d len %d: got 0x%08x, expected 0x%08x",
+							types[t].name, mname, (int)offset, (int)len,
+							(UI)x, (UI)expected);
+						nfailures++;
+					}
+
+					// Only test the combine function once per length.
+					if(offset!=0) continue;
+					for(split=0; split<=len; split++) {
+						de_crcobj_reset(crco);
+						de_crcobj_addbuf(crco, p, split);
+						crc_selftest_calc(crco2, &p[split], len-split);
+						de_crcobj_combine(crco, crco2->val, len-split);
+						if(crco->val != expected) {
+							de_err(c, "%s %s: combine len %d split %d: got 0x%08x, "
+								"expected 0x%08x", types[t].name, mname, (int)len,
+								(int)split, (UI)crco->val, (UI)expected);
+							nfailures++;
+						}
+					}
+				}
+			}
+
+			if(nfailures==nfailures_prev) {
+				de_msg(c, "%s %s: passed", types[t].name, mname);
+			}
+		}
+
+		for(m=0; m<nmethods; m++) {
+			const char *mname = m ? "HW" : "SW";
+
+			crco->use_hw_crc32 = (u8)m;
+			de_msg(c, "%s %s: %.1f MB/s", types[t].name, mname,
+				crc_selftest_benchmark(crco, buf, CRC_SELFTEST_BENCH_LEN, 0,
+					CRC_SELFTEST_BENCH_ITER));
+			de_msg(c, "%s %s, 64KB pieces + combine: %.1f MB/s", types[t].name, mname,
+				crc_selftest_benchmark(crco, buf, CRC_SELFTEST_BENCH_LEN, 65536,
+					CRC_SELFTEST_BENCH_ITER));
+		}
+
+		de_crcobj_destroy(crco);
+		de_crcobj_destroy(crco2);
+	}
+
+	de_free(c, buf);
+	return nfailures;
+}
+
 void de_get_reproducible_timestamp(deark *c, struct de_timestamp *ts)
 {
 	if(c->reproducible_timestamp.is_valid) {
@@ -11,6 +11,7 @@
 #ifdef DE_WINDOWS
 
 #include <windows.h>
+#include <io.h> // for _get_osfhandle
 
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -26,6 +27,12 @@
 #define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
 #endif
 
+struct de_thread_struct {
+	HANDLE hThread;
+	de_thread_fn_type fn;
+	void *userdata;
+};
+
 // Windows-specific contextual data, mainly for console settings.
 struct de_platform_data {
 	HANDLE msgs_HANDLE;
@@ -282,6 +289,46 @@ int de_fclose(FILE *fp)
 	return fclose(fp);
 }
 
+// Map a file that has been opened for reading into memory.
+// Returns NULL if that's not possible, in which case the caller should fall
+// back to using stdio. The returned pointer must be released with
+// de_munmap().
+const u8 *de_mmap_for_read(deark *c, FILE *fp, i64 len, void **phandle)
+{
+	HANDLE fh;
+	HANDLE mh;
+	void *mem;
+
+	*phandle = NULL;
+	if(len<1) return NULL;
+	if((u64)len > (u64)(SIZE_T)(-1)) return NULL;
+
+	fh = (HANDLE)_get_osfhandle(_fileno(fp));
+	if(fh==INVALID_HANDLE_VALUE) return NULL;
+
+	mh = CreateFileMappingW(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!mh) return NULL;
+
+	mem = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, (SIZE_T)len);
+	if(!mem) {
+		de_dbg2(c, "MapViewOfFile failed");
+		CloseHandle(mh);
+		return NULL;
+	}
+
+	*phandle = (void*)mh;
+	return (const u8*)mem;
+}
+
+void de_munmap(deark *c, const u8 *mem, i64 len, void *handle)
+{
+	if(!mem) return;
+	UnmapViewOfFile((LPCVOID)mem);
+	if(handle) {
+		CloseHandle((HANDLE)handle);
+	}
+}
+
 static void update_file_time(dbuf *f)
 {
 	WCHAR *fnW = NULL;
@@ -487,9 +534,69 @@ void de_current_time_to_timestamp(struct de_timestamp *ts)
 	de_FILETIME_to_timestamp(ft, ts, 0x1);
 }
 
+// Returns a time in nanoseconds, relative to some arbitrary starting point.
+// Only useful for measuring elapsed time.
+i64 de_get_highres_time_ns(void)
+{
+	static LARGE_INTEGER freq = {0};
+	LARGE_INTEGER t;
+
+	if(freq.QuadPart==0) {
+		if(!QueryPerformanceFrequency(&freq)) return 0;
+	}
+	QueryPerformanceCounter(&t);
+	return (i64)((double)t.QuadPart * (1000000000.0 / (double)freq.QuadPart));
+}
+
 void de_exitprocess(int s)
 {
 	exit(s);
 }
 
+// Worker processes are not supported on Windows. The parallel batch mode
+// falls back to processing the files one at a time.
+i64 de_start_worker_process(de_worker_fn_type fn, void *userdata)
+{
+	return -1;
+}
+
+i64 de_wait_for_worker_process(int *pexit_status)
+{
+	return -1;
+}
+
+static DWORD WINAPI thread_start_routine(LPVOID arg)
+{
+	de_thread *t = (de_thread*)arg;
+
+	t->fn(t->userdata);
+	return 0;
+}
+
+// Returns NULL if the thread could not be started. In that case, the caller
+// should call fn itself.
+de_thread *de_thread_create(deark *c, de_thread_fn_type fn, void *userdata)
+{
+	de_thread *t;
+
+	t = de_malloc(c, sizeof(de_thread));
+	t->fn = fn;
+	t->userdata = userdata;
+	t->hThread = CreateThread(NULL, 0, thread_start_routine, (LPVOID)t, 0, NULL);
+	if(!t->hThread) {
+		de_free(c, t);
+		return NULL;
+	}
+	return t;
+}
+
+// Waits for the thread to finish, and frees t.
+void de_thread_join(deark *c, de_thread *t)
+{
+	if(!t) return;
+	WaitForSingleObject(t->hThread, INFINITE);
+	CloseHandle(t->hThread);
+	de_free(c, t);
+}
+
 #endif // DE_WINDOWS
@@ -18,6 +18,34 @@
 #define CODE_PK12 0x02014b50U
 #define CODE_PK34 0x04034b50U
 #define CODE_PK56 0x06054b50U
+#define CODE_PK78 0x08074b50U
+#define CODE_PK66 0x06064b50U
+#define CODE_PK67 0x07064b50U
+
+// Values this large (or larger) must be stored in ZIP64 fields
+#define ZIPW_MAX32 0xffffffffLL
+#define ZIPW_MAX16 0xffffLL
+
+#define ZIPW_MAX_THREADS 64
+// When using multiple threads: Max number of member files, and bytes, to
+// collect before compressing them.
+#define ZIPW_MAX_QUEUED_PER_THREAD 16
+#define ZIPW_MAX_QUEUED_BYTES (64*1024*1024)
+// When using multiple threads, streamed member files are compressed in
+// blocks of this size.
+#define ZIPW_BLOCK_SIZE (1024*1024)
+
+// Before compressing a member file at least this large, compress a few
+// samples of it at a low level, to see if it's worth doing.
+#define ZIPW_TRIAL_MIN_SIZE (128*1024)
+#define ZIPW_TRIAL_SAMPLE_SIZE (16*1024)
+
+// Why a member file was stored uncompressed
+#define ZIPW_STORED_NOT_TRIED      1 // Directory, tiny file, or level 0
+#define ZIPW_STORED_BY_EXT         2
+#define ZIPW_STORED_BY_TRIAL       3
+#define ZIPW_STORED_NO_SAVINGS     4
+#define ZIPW_STORED_CMPR_ERROR     5
 
 struct zipw_md {
 	struct de_timestamp modtime;
@@ -35,6 +63,82 @@ struct zipw_md {
 	dbuf *efcentral;
 };
 
+// The fields that go in both the local header and the central directory
+struct zipw_member {
+	i64 ldir_offset;
+	u32 crc;
+	i64 cmpr_len;
+	i64 uncmpr_len;
+	unsigned int ver_needed;
+	unsigned int bit_flags;
+	unsigned int cmpr_meth;
+	u8 zip64_local; // Local header has a ZIP64 extra field
+};
+
+// The part of the work of adding a member file that can be done by a
+// separate thread: calculating the CRC, and compressing the data.
+struct zipw_cmprjob {
+	deark *c;
+	dbuf *inf; // A membuf
+	unsigned int level;
+	u8 try_compression;
+	u8 do_trial;
+	u32 crc;
+	dbuf *cmpr_data; // NULL if not compressed
+	int stored_reason; // ZIPW_STORED_*, if cmpr_data is NULL
+	u8 cmpr_failed; // Reported by the main thread
+	i64 cmpr_time_ns;
+};
+
+struct zipw_stats {
+	i64 num_stored[6]; // Indexed by ZIPW_STORED_*
+	i64 num_compressed;
+	i64 uncmpr_bytes_compressed;
+	i64 cmpr_bytes_compressed;
+	i64 bytes_stored_by_policy;
+	i64 cmpr_time_ns;
+};
+
+// One block of a streamed member file, when using multiple threads.
+// The compressed blocks are simply concatenated. Each block is compressed
+// independently, and all but the last end with a sync flush.
+struct zipw_blockjob {
+	deark *c;
+	dbuf *inf; // A membuf
+	unsigned int level;
+	u8 is_last_block;
+	dbuf *cmpr_data;
+	struct de_crcobj *crco;
+	u32 crc; // CRC of this block by itself
+	u8 cmpr_failed; // Reported by the main thread
+};
+
+// A member file waiting to be compressed by a thread
+struct zipw_queued_member {
+	dbuf *f;
+	struct zipw_md *md;
+	struct zipw_cmprjob job;
+};
+
+// A member file that is being compressed and written as its data arrives
+struct zipw_stream {
+	struct zipw_md *md;
+	struct zipw_member mbr;
+	struct fmtutil_tdefl_ctx *tdctx; // NULL if not compressing
+	// If using multiple threads, this is used instead of tdctx
+	struct zipw_blockjob *blocks; // array[num_threads]
+	int num_blocks_used;
+	i64 data_start;
+	i64 zip64_ef_pos; // Where the ZIP64 sizes are, if mbr.zip64_local
+	u8 use_data_descriptor;
+	u8 compress;
+	// Not really compressing: using Deflate only to store the data in
+	// uncompressed blocks. stored_reason is still valid.
+	u8 deflate_stored;
+	int stored_reason; // ZIPW_STORED_*, if !compress or deflate_stored
+	i64 cmpr_time_ns;
+};
+
 struct zipw_ctx {
 	deark *c;
 	const char *pFilename;
@@ -43,6 +147,22 @@ struct zipw_ctx {
 	dbuf *outf;
 	dbuf *cdir; // central directory
 	struct de_crcobj *crc32o;
+
+	// Only one member can be streamed at a time. Member files that are
+	// completed while that is happening are held here until it's done.
+	struct zipw_stream *strm;
+	i64 num_pending;
+	i64 pending_alloc;
+	dbuf **pending;
+
+	u8 cmpr_check;
+	struct zipw_stats stats;
+
+	int num_threads;
+	// Member files waiting to be compressed, if num_threads>1
+	i64 num_queued;
+	i64 queued_bytes;
+	struct zipw_queued_member **queue; // array[num_threads*ZIPW_MAX_QUEUED_PER_THREAD]
 };
 
 static int is_valid_32bit_unix_time(i64 ut)
@@ -55,6 +175,7 @@ int de_zip_create_file(deark *c)
 {
 	struct zipw_ctx *zzz;
 	const char *opt_level;
+	const char *opt_threads;
 
 	if(c->zip_data) return 1; // Already created. Shouldn't happen.
 
@@ -78,6 +199,20 @@ int de_zip_create_file(deark *c)
 		}
 	}
 
+	zzz->cmpr_check = (u8)de_get_ext_option_bool(c, "archive:zipcmprcheck", 1);
+
+	zzz->num_threads = 1;
+	opt_threads = de_get_ext_option(c, "archive:threads");
+	if(opt_threads) {
+		zzz->num_threads = (int)de_atoi64(opt_threads);
+		if(zzz->num_threads<1) zzz->num_threads = 1;
+		if(zzz->num_threads>ZIPW_MAX_THREADS) zzz->num_threads = ZIPW_MAX_THREADS;
+	}
+	if(zzz->num_threads>1) {
+		zzz->queue = de_mallocarray(c, zzz->num_threads*ZIPW_MAX_QUEUED_PER_THREAD,
+			sizeof(struct zipw_queued_member*));
+	}
+
 	if(c->archive_to_stdout) {
 		zzz->pFilename = "[stdout]";
 	}
@@ -209,8 +344,11 @@ static void do_ntfs_times(deark *c, struct zipw_md *md,
 	dbuf_writeu64le(ef, crtm);
 }
 
-static int zipw_deflate(deark *c, struct zipw_ctx *zzz, dbuf *uncmpr_data,
-	dbuf *cmpr_data, unsigned int level)
+// May be called by a separate thread, so it does not report errors. The
+// caller must do that, from the main thread.
+// Returns 0 on failure.
+static int zipw_deflate(deark *c, dbuf *uncmpr_data,
+	dbuf *cmpr_data, unsigned int level, enum fmtutil_tdefl_flush flush)
 {
 	int retval = 0;
 	enum fmtutil_tdefl_status ret;
@@ -220,9 +358,10 @@ static int zipw_deflate(deark *c, struct zipw_ctx *zzz, dbuf *uncmpr_data,
 		fmtutil_tdefl_create_comp_flags_from_zip_params(level, -15, MZ_DEFAULT_STRATEGY));
 
 	ret = fmtutil_tdefl_compress_buffer(tdctx, uncmpr_data->membuf_buf,
-		(size_t)uncmpr_data->len, FMTUTIL_TDEFL_FINISH);
-	if(ret != FMTUTIL_TDEFL_STATUS_DONE) {
-		de_err(c, "Deflate compression error");
+		(size_t)uncmpr_data->len, flush);
+	if(ret != ((flush==FMTUTIL_TDEFL_FINISH) ? FMTUTIL_TDEFL_STATUS_DONE :
+		FMTUTIL_TDEFL_STATUS_OKAY))
+	{
 		goto done;
 	}
 	retval = 1;
@@ -232,171 +371,337 @@ done:
 	return retval;
 }
 
-static void zipw_add_memberfile(deark *c, struct zipw_ctx *zzz, struct zipw_md *md,
-	dbuf *f, const char *name, unsigned int level_and_flags)
+// Extensions of formats that are (almost always) already compressed
+static const char *zipw_cmpr_exts[] = { "jpg", "jpeg", "png", "gif", "zip",
+	"gz", "bz2", "xz", "7z", "rar", "lzh", "mp3", "ogg", "flac", "jp2",
+	"j2c", "webp", "bpg", "flif", "cab", "docx", "xlsx", "pptx", "odt", "jar" };
+
+static int zipw_is_cmpr_ext(const char *name)
 {
-	i64 ldir_offset;
-	i64 fnlen;
-	u32 crc;
-	int try_compression = 0;
-	int using_compression = 0;
-	dbuf *cmpr_data = NULL;
-	i64 cmpr_len;
-	unsigned int bit_flags = 0;
-	unsigned int ext_attributes;
-	unsigned int ver_needed;
+	size_t i;
 
-	if(zzz->membercount >= 0xffff) {
-		de_err(c, "Maximum number of ZIP member files exceeded");
-		goto done;
+	for(i=0; i<DE_ARRAYCOUNT(zipw_cmpr_exts); i++) {
+		if(de_sz_has_ext(name, zipw_cmpr_exts[i])) return 1;
 	}
+	return 0;
+}
 
-	de_crcobj_reset(zzz->crc32o);
-	de_crcobj_addslice(zzz->crc32o, f, 0, f->len);
-	crc = de_crcobj_getval(zzz->crc32o);
-
-	ldir_offset = zzz->outf->len;
-	if(ldir_offset > 0xffffffffLL) {
-		de_err(c, "Maximum ZIP file size exceeded");
-		goto done;
+// Compress some samples of mem (from the start, middle, and end) at a low
+// level. Returns 0 if compression does not look worthwhile.
+// May be called by a separate thread.
+static int zipw_trial_compress(deark *c, const u8 *mem, i64 len)
+{
+	dbuf *inf = NULL;
+	dbuf *outf = NULL;
+	i64 pos[3];
+	i64 total_in = 0;
+	int i;
+	int retval;
+
+	if(len < ZIPW_TRIAL_MIN_SIZE) return 1;
+
+	pos[0] = 0;
+	pos[1] = (len - ZIPW_TRIAL_SAMPLE_SIZE)/2;
+	pos[2] = len - ZIPW_TRIAL_SAMPLE_SIZE;
+
+	inf = dbuf_create_membuf(c, ZIPW_TRIAL_SAMPLE_SIZE, 0);
+	outf = dbuf_create_membuf(c, ZIPW_TRIAL_SAMPLE_SIZE+1024, 0);
+	for(i=0; i<3; i++) {
+		dbuf_truncate(inf, 0);
+		dbuf_write(inf, &mem[pos[i]], ZIPW_TRIAL_SAMPLE_SIZE);
+		if(!zipw_deflate(c, inf, outf, 1, FMTUTIL_TDEFL_FINISH)) {
+			// Inconclusive. Let the real compression fail, and report it.
+			retval = 1;
+			goto done;
+		}
+		total_in += ZIPW_TRIAL_SAMPLE_SIZE;
 	}
-	if(f->len > 0xffffffffLL) {
-		de_err(c, "Maximum ZIP member file size exceeded");
+
+	// Require a savings of at least 2%
+	retval = (outf->len < total_in - total_in/50);
+done:
+	dbuf_close(inf);
+	dbuf_close(outf);
+	return retval;
+}
+
+// May be called by a separate thread.
+static void zipw_cmprjob_run(void *userdata)
+{
+	struct zipw_cmprjob *job = (struct zipw_cmprjob*)userdata;
+	deark *c = job->c;
+	struct de_crcobj *crco;
+	i64 t0;
+
+	crco = de_crcobj_create(c, DE_CRCOBJ_CRC32_IEEE);
+	de_crcobj_addslice(crco, job->inf, 0, job->inf->len);
+	job->crc = de_crcobj_getval(crco);
+	de_crcobj_destroy(crco);
+
+	if(!job->try_compression) return;
+
+	t0 = de_get_highres_time_ns();
+	if(job->do_trial && !zipw_trial_compress(c, job->inf->membuf_buf, job->inf->len)) {
+		job->stored_reason = ZIPW_STORED_BY_TRIAL;
 		goto done;
 	}
-	cmpr_len = f->len; // default
 
-	if(f->len>5 && !md->is_directory) {
-		try_compression = 1;
+	job->cmpr_data = dbuf_create_membuf(c, 0, 0);
+	if(!zipw_deflate(c, job->inf, job->cmpr_data, job->level, FMTUTIL_TDEFL_FINISH)) {
+		// Fall back to storing the file uncompressed
+		dbuf_close(job->cmpr_data);
+		job->cmpr_data = NULL;
+		job->stored_reason = ZIPW_STORED_CMPR_ERROR;
+		job->cmpr_failed = 1;
+	}
+	else if(job->cmpr_data->len >= job->inf->len) {
+		// No savings - Discard compressed data
+		dbuf_close(job->cmpr_data);
+		job->cmpr_data = NULL;
+		job->stored_reason = ZIPW_STORED_NO_SAVINGS;
 	}
 
-	if(try_compression) {
-		unsigned int level;
+done:
+	job->cmpr_time_ns = de_get_highres_time_ns() - t0;
+}
 
-		cmpr_data = dbuf_create_membuf(c, 0, 0);
+// May be called by a separate thread.
+static void zipw_blockjob_run(void *userdata)
+{
+	struct zipw_blockjob *bj = (struct zipw_blockjob*)userdata;
 
-		if ((int)level_and_flags < 0)
-			level_and_flags = MZ_DEFAULT_LEVEL;
-		level = level_and_flags & 0xF;
+	de_crcobj_reset(bj->crco);
+	de_crcobj_addslice(bj->crco, bj->inf, 0, bj->inf->len);
+	bj->crc = de_crcobj_getval(bj->crco);
 
-		zipw_deflate(c, zzz, f, cmpr_data, level);
+	bj->cmpr_data = dbuf_create_membuf(bj->c, 0, 0);
+	if(!zipw_deflate(bj->c, bj->inf, bj->cmpr_data, bj->level,
+		bj->is_last_block ? FMTUTIL_TDEFL_FINISH : FMTUTIL_TDEFL_SYNC_FLUSH))
+	{
+		bj->cmpr_failed = 1;
+	}
+}
 
-		if(cmpr_data->len < f->len) {
-			using_compression = 1;
-			cmpr_len = cmpr_data->len;
+static unsigned int zipw_get_ext_attributes(struct zipw_md *md)
+{
+	// Set the Unix (etc.) file attributes to "-rw-r--r--" or
+	// "-rwxr-xr-x", etc.
+	if(md->is_directory)
+		return (0040755U << 16) | 0x10;
+	if(md->is_executable)
+		return (0100755U << 16);
+	return (0100644U << 16);
+}
 
-			// This is the logic used by Info-Zip
-			if(level<=2) bit_flags |= 4;
-			else if(level>=8) bit_flags |= 2;
-		}
-		else { // No savings - Discard compressed data
-			dbuf_close(cmpr_data);
-			cmpr_data = NULL;
-		}
+static void zipw_write_local_header(struct zipw_ctx *zzz, struct zipw_md *md,
+	const char *name, const struct zipw_member *mbr)
+{
+	dbuf *outf = zzz->outf;
+	i64 fnlen;
+
+	fnlen = de_strlen(name);
+	dbuf_writeu32le(outf, CODE_PK34);
+	dbuf_writeu16le(outf, mbr->ver_needed);
+	dbuf_writeu16le(outf, mbr->bit_flags);
+	dbuf_writeu16le(outf, mbr->cmpr_meth);
+	dbuf_writeu16le(outf, md->modtime_dostime);
+	dbuf_writeu16le(outf, md->modtime_dosdate);
+	dbuf_writeu32le(outf, mbr->crc);
+	if(mbr->zip64_local) {
+		dbuf_writeu32le(outf, ZIPW_MAX32);
+		dbuf_writeu32le(outf, ZIPW_MAX32);
+	}
+	else {
+		dbuf_writeu32le(outf, mbr->cmpr_len);
+		dbuf_writeu32le(outf, mbr->uncmpr_len);
+	}
+	dbuf_writeu16le(outf, fnlen);
+	dbuf_writeu16le(outf, md->eflocal->len + (mbr->zip64_local ? 20 : 0));
+	dbuf_write(outf, (const u8*)name, fnlen);
+	if(mbr->zip64_local) {
+		// In the local header, the ZIP64 extra field must contain both sizes.
+		dbuf_writeu16le(outf, 0x0001);
+		dbuf_writeu16le(outf, 16);
+		dbuf_writeu64le(outf, (u64)mbr->uncmpr_len);
+		dbuf_writeu64le(outf, (u64)mbr->cmpr_len);
 	}
+	dbuf_copy(md->eflocal, 0, md->eflocal->len, outf);
+}
+
+static void zipw_write_cdir_entry(struct zipw_ctx *zzz, struct zipw_md *md,
+	const char *name, const struct zipw_member *mbr)
+{
+	dbuf *cdir = zzz->cdir;
+	i64 fnlen;
+	i64 zip64_ef_len = 0;
+	u8 big_uncmpr_len, big_cmpr_len, big_ldir_offset;
+	unsigned int ver_needed;
 
-	bit_flags |= 0x0800; // Use UTF-8 filenames
+	// Only the fields that don't fit go in the ZIP64 extra field.
+	big_uncmpr_len = (mbr->uncmpr_len >= ZIPW_MAX32);
+	big_cmpr_len = (mbr->cmpr_len >= ZIPW_MAX32);
+	big_ldir_offset = (mbr->ldir_offset >= ZIPW_MAX32);
+	if(big_uncmpr_len) zip64_ef_len += 8;
+	if(big_cmpr_len) zip64_ef_len += 8;
+	if(big_ldir_offset) zip64_ef_len += 8;
 
-	dbuf_writeu32le(zzz->cdir, CODE_PK12);
-	dbuf_writeu32le(zzz->outf, CODE_PK34);
+	ver_needed = mbr->ver_needed;
+	if(zip64_ef_len>0 && ver_needed<45) ver_needed = 45;
 
+	fnlen = de_strlen(name);
+	dbuf_writeu32le(cdir, CODE_PK12);
 	// 03xx = Unix
 	// 63 decimal = ZIP spec v6.3 (first version to document the UTF-8 flag)
-	dbuf_writeu16le(zzz->cdir, (3<<8) | 63); // version made by
-
-	if(using_compression) ver_needed = 20;
-	else if(md->is_directory) ver_needed = 20;
-	else ver_needed = 10;
+	dbuf_writeu16le(cdir, (3<<8) | 63); // version made by
+	dbuf_writeu16le(cdir, ver_needed);
+	dbuf_writeu16le(cdir, mbr->bit_flags);
+	dbuf_writeu16le(cdir, mbr->cmpr_meth);
+	dbuf_writeu16le(cdir, md->modtime_dostime);
+	dbuf_writeu16le(cdir, md->modtime_dosdate);
+	dbuf_writeu32le(cdir, mbr->crc);
+	dbuf_writeu32le(cdir, big_cmpr_len ? ZIPW_MAX32 : mbr->cmpr_len);
+	dbuf_writeu32le(cdir, big_uncmpr_len ? ZIPW_MAX32 : mbr->uncmpr_len);
+	dbuf_writeu16le(cdir, fnlen);
+	dbuf_writeu16le(cdir, md->efcentral->len + (zip64_ef_len>0 ? 4+zip64_ef_len : 0)); // eflen
+	dbuf_writeu16le(cdir, 0); // file comment len
+	dbuf_writeu16le(cdir, 0); // disk number start
+	dbuf_writeu16le(cdir, 0); // int attrib
+	dbuf_writeu32le(cdir, (i64)zipw_get_ext_attributes(md)); // ext attrib
+	dbuf_writeu32le(cdir, big_ldir_offset ? ZIPW_MAX32 : mbr->ldir_offset);
+	dbuf_write(cdir, (const u8*)name, fnlen);
+	if(zip64_ef_len>0) {
+		dbuf_writeu16le(cdir, 0x0001);
+		dbuf_writeu16le(cdir, zip64_ef_len);
+		if(big_uncmpr_len) dbuf_writeu64le(cdir, (u64)mbr->uncmpr_len);
+		if(big_cmpr_len) dbuf_writeu64le(cdir, (u64)mbr->cmpr_len);
+		if(big_ldir_offset) dbuf_writeu64le(cdir, (u64)mbr->ldir_offset);
+	}
+	dbuf_copy(md->efcentral, 0, md->efcentral->len, cdir);
+}
 
-	dbuf_writeu16le(zzz->cdir, ver_needed);
-	dbuf_writeu16le(zzz->outf, ver_needed);
+// Called after a member file has been completely written.
+// If we're writing to stdout, don't leave the member sitting in the stdio
+// buffer: a downstream consumer can start working on it now.
+static void zipw_member_written(struct zipw_ctx *zzz)
+{
+	if(zzz->outf->btype==DBUF_TYPE_STDOUT) {
+		dbuf_flush(zzz->outf);
+	}
+}
 
-	dbuf_writeu16le(zzz->cdir, bit_flags);
-	dbuf_writeu16le(zzz->outf, bit_flags);
+// Sets the "compression option" flags. This is the logic used by Info-Zip.
+static unsigned int zipw_level_to_bit_flags(unsigned int level)
+{
+	if(level<=2) return 4;
+	if(level>=8) return 2;
+	return 0;
+}
 
-	dbuf_writeu16le(zzz->cdir, using_compression?8:0); // cmpr method
-	dbuf_writeu16le(zzz->outf, using_compression?8:0);
+static void zipw_cmprjob_init(deark *c, struct zipw_ctx *zzz, struct zipw_cmprjob *job,
+	struct zipw_md *md, dbuf *f, const char *name, unsigned int level_and_flags)
+{
+	de_zeromem(job, sizeof(struct zipw_cmprjob));
+	job->c = c;
+	job->inf = f;
+	if ((int)level_and_flags < 0)
+		level_and_flags = MZ_DEFAULT_LEVEL;
+	job->level = level_and_flags & 0xF;
+
+	job->stored_reason = ZIPW_STORED_NOT_TRIED;
+	if(f->len>5 && !md->is_directory && job->level>0) {
+		job->try_compression = 1;
+	}
 
-	dbuf_writeu16le(zzz->cdir, md->modtime_dostime);
-	dbuf_writeu16le(zzz->outf, md->modtime_dostime);
-	dbuf_writeu16le(zzz->cdir, md->modtime_dosdate);
-	dbuf_writeu16le(zzz->outf, md->modtime_dosdate);
+	if(job->try_compression && zzz->cmpr_check) {
+		if(zipw_is_cmpr_ext(name)) {
+			job->try_compression = 0;
+			job->stored_reason = ZIPW_STORED_BY_EXT;
+		}
+		else {
+			job->do_trial = 1;
+		}
+	}
+}
 
-	dbuf_writeu32le(zzz->cdir, crc); // crc
-	dbuf_writeu32le(zzz->outf, crc);
+static void zipw_update_stats(struct zipw_ctx *zzz, struct zipw_cmprjob *job)
+{
+	zzz->stats.cmpr_time_ns += job->cmpr_time_ns;
+	if(job->cmpr_data) {
+		zzz->stats.num_compressed++;
+		zzz->stats.uncmpr_bytes_compressed += job->inf->len;
+		zzz->stats.cmpr_bytes_compressed += job->cmpr_data->len;
+		return;
+	}
+	zzz->stats.num_stored[job->stored_reason]++;
+	if(job->stored_reason==ZIPW_STORED_BY_EXT || job->stored_reason==ZIPW_STORED_BY_TRIAL) {
+		zzz->stats.bytes_stored_by_policy += job->inf->len;
+	}
+}
 
-	dbuf_writeu32le(zzz->cdir, cmpr_len); // cmpr size
-	dbuf_writeu32le(zzz->outf, cmpr_len);
-	dbuf_writeu32le(zzz->cdir, f->len); // uncmpr size
-	dbuf_writeu32le(zzz->outf, f->len);
+// Write member file f to the ZIP file. job must have already been run.
+static void zipw_add_memberfile(deark *c, struct zipw_ctx *zzz, struct zipw_md *md,
+	dbuf *f, const char *name, struct zipw_cmprjob *job)
+{
+	struct zipw_member mbr;
+	int using_compression = 0;
 
-	fnlen = de_strlen(name);
-	dbuf_writeu16le(zzz->cdir, fnlen);
-	dbuf_writeu16le(zzz->outf, fnlen);
+	de_zeromem(&mbr, sizeof(struct zipw_member));
 
-	dbuf_writeu16le(zzz->cdir, md->efcentral->len); // eflen
-	dbuf_writeu16le(zzz->outf, md->eflocal->len);
+	if(job->cmpr_failed) {
+		de_err(c, "Deflate compression error");
+	}
+	zipw_update_stats(zzz, job);
 
-	dbuf_writeu16le(zzz->cdir, 0); // file comment len
-	dbuf_writeu16le(zzz->cdir, 0); // disk number start
+	mbr.crc = job->crc;
+	mbr.ldir_offset = zzz->outf->len;
+	mbr.uncmpr_len = f->len;
+	mbr.cmpr_len = f->len; // default
 
-	dbuf_writeu16le(zzz->cdir, 0); // int attrib
+	if(job->cmpr_data) {
+		using_compression = 1;
+		mbr.cmpr_len = job->cmpr_data->len;
+		mbr.bit_flags |= zipw_level_to_bit_flags(job->level);
+	}
 
-	// Set the Unix (etc.) file attributes to "-rw-r--r--" or
-	// "-rwxr-xr-x", etc.
-	if(md->is_directory)
-		ext_attributes = (0040755U << 16) | 0x10;
-	else if(md->is_executable)
-		ext_attributes = (0100755U << 16);
-	else
-		ext_attributes = (0100644U << 16);
+	mbr.bit_flags |= 0x0800; // Use UTF-8 filenames
 
-	dbuf_writeu32le(zzz->cdir, (i64)ext_attributes); // ext attrib
+	if(using_compression) mbr.ver_needed = 20;
+	else if(md->is_directory) mbr.ver_needed = 20;
+	else mbr.ver_needed = 10;
 
-	dbuf_writeu32le(zzz->cdir, ldir_offset);
+	mbr.cmpr_meth = using_compression?8:0;
 
-	dbuf_write(zzz->cdir, (const u8*)name, fnlen);
-	dbuf_write(zzz->outf, (const u8*)name, fnlen);
+	if(mbr.uncmpr_len >= ZIPW_MAX32 || mbr.cmpr_len >= ZIPW_MAX32) {
+		mbr.zip64_local = 1;
+	}
+	if(mbr.zip64_local || mbr.ldir_offset >= ZIPW_MAX32) {
+		mbr.ver_needed = 45;
+	}
 
-	dbuf_copy(md->efcentral, 0, md->efcentral->len, zzz->cdir);
-	dbuf_copy(md->eflocal, 0, md->eflocal->len, zzz->outf);
+	zipw_write_local_header(zzz, md, name, &mbr);
 
 	if(using_compression) {
-		if(cmpr_data) {
-			dbuf_copy(cmpr_data, 0, cmpr_data->len, zzz->outf);
-		}
+		dbuf_copy(job->cmpr_data, 0, job->cmpr_data->len, zzz->outf);
 	}
 	else {
 		dbuf_copy(f, 0, f->len, zzz->outf);
 	}
 
-	zzz->membercount++;
+	zipw_write_cdir_entry(zzz, md, name, &mbr);
 
-done:
-	if(cmpr_data) dbuf_close(cmpr_data);
+	zzz->membercount++;
+	zipw_member_written(zzz);
 }
 
-void de_zip_add_file_to_archive(deark *c, dbuf *f)
+// Collect the metadata (timestamps, etc.) for member file f.
+static struct zipw_md *zipw_md_create(deark *c, dbuf *f)
 {
-	struct zipw_ctx *zzz;
-	struct zipw_md *md = NULL;
+	struct zipw_md *md;
 	int write_ntfs_times = 0;
 	int write_UT_time = 0;
 
 	md = de_malloc(c, sizeof(struct zipw_md));
 
-	if(!c->zip_data) {
-		// ZIP file hasn't been created yet
-		if(!de_zip_create_file(c)) {
-			de_fatalerror(c);
-			goto done;
-		}
-	}
-
-	zzz = (struct zipw_ctx*)c->zip_data;
-
-	de_dbg(c, "adding to zip: name=%s len=%"I64_FMT, f->name, f->len);
-
 	if(f->fi_copy && f->fi_copy->is_directory) {
 		md->is_directory = 1;
 	}
@@ -480,6 +785,157 @@ void de_zip_add_file_to_archive(deark *c, dbuf *f)
 		do_ntfs_times(c, md, md->efcentral, 1);
 	}
 
+	return md;
+}
+
+static void zipw_md_destroy(deark *c, struct zipw_md *md)
+{
+	if(!md) return;
+	dbuf_close(md->eflocal);
+	dbuf_close(md->efcentral);
+	de_free(c, md);
+}
+
+static struct zipw_ctx *zipw_get_ctx(deark *c)
+{
+	if(!c->zip_data) {
+		// ZIP file hasn't been created yet
+		if(!de_zip_create_file(c)) {
+			de_fatalerror(c);
+			return NULL;
+		}
+	}
+	return (struct zipw_ctx*)c->zip_data;
+}
+
+// Returns a new membuf containing the data, name, and finfo of member file
+// f, which are taken from f (which is about to be closed).
+static dbuf *zipw_take_member_data(deark *c, dbuf *f)
+{
+	dbuf *g;
+
+	g = dbuf_create_membuf(c, 0, 0);
+	g->membuf_buf = f->membuf_buf;
+	g->membuf_alloc = f->membuf_alloc;
+	g->len = f->len;
+	g->name = f->name;
+	g->fi_copy = f->fi_copy;
+	f->membuf_buf = NULL;
+	f->membuf_alloc = 0;
+	f->name = NULL;
+	f->fi_copy = NULL;
+	return g;
+}
+
+// While a member file is being streamed, we can't write another one. Keep
+// this one's data until we can.
+static void zipw_defer_member(deark *c, struct zipw_ctx *zzz, dbuf *f)
+{
+	dbuf *g;
+
+	de_dbg(c, "deferring zip member %s", f->name);
+	g = zipw_take_member_data(c, f);
+
+	if(zzz->num_pending >= zzz->pending_alloc) {
+		i64 new_alloc = zzz->pending_alloc ? zzz->pending_alloc*2 : 8;
+
+		zzz->pending = de_reallocarray(c, zzz->pending, zzz->pending_alloc,
+			sizeof(dbuf*), new_alloc);
+		zzz->pending_alloc = new_alloc;
+	}
+	zzz->pending[zzz->num_pending++] = g;
+}
+
+static void zipw_flush_pending_members(deark *c, struct zipw_ctx *zzz)
+{
+	i64 i;
+
+	for(i=0; i<zzz->num_pending; i++) {
+		de_zip_add_file_to_archive(c, zzz->pending[i]);
+		dbuf_close(zzz->pending[i]);
+	}
+	de_free(c, zzz->pending);
+	zzz->pending = NULL;
+	zzz->num_pending = 0;
+	zzz->pending_alloc = 0;
+}
+
+// Compress the queued member files, using multiple threads, then write them
+// to the ZIP file in order.
+static void zipw_flush_queue(deark *c, struct zipw_ctx *zzz)
+{
+	void **jobs = NULL;
+	i64 i;
+
+	if(zzz->num_queued<1) return;
+	de_dbg(c, "compressing %"I64_FMT" queued zip members", zzz->num_queued);
+
+	jobs = de_mallocarray(c, zzz->num_queued, sizeof(void*));
+	for(i=0; i<zzz->num_queued; i++) {
+		jobs[i] = (void*)&zzz->queue[i]->job;
+	}
+	de_run_jobs_in_parallel(c, zipw_cmprjob_run, jobs, zzz->num_queued,
+		zzz->num_threads);
+	de_free(c, jobs);
+
+	for(i=0; i<zzz->num_queued; i++) {
+		struct zipw_queued_member *qm = zzz->queue[i];
+
+		zipw_add_memberfile(c, zzz, qm->md, qm->f, qm->f->name, &qm->job);
+		dbuf_close(qm->job.cmpr_data);
+		zipw_md_destroy(c, qm->md);
+		dbuf_close(qm->f);
+		de_free(c, qm);
+		zzz->queue[i] = NULL;
+	}
+	zzz->num_queued = 0;
+	zzz->queued_bytes = 0;
+}
+
+static void zipw_queue_member(deark *c, struct zipw_ctx *zzz, dbuf *f,
+	struct zipw_md *md)
+{
+	struct zipw_queued_member *qm;
+
+	qm = de_malloc(c, sizeof(struct zipw_queued_member));
+	qm->f = zipw_take_member_data(c, f);
+	qm->md = md;
+	zipw_cmprjob_init(c, zzz, &qm->job, md, qm->f, qm->f->name, zzz->cmprlevel);
+	zzz->queue[zzz->num_queued++] = qm;
+	zzz->queued_bytes += qm->f->len;
+
+	if(zzz->num_queued >= (i64)zzz->num_threads*ZIPW_MAX_QUEUED_PER_THREAD ||
+		zzz->queued_bytes >= ZIPW_MAX_QUEUED_BYTES)
+	{
+		zipw_flush_queue(c, zzz);
+	}
+}
+
+void de_zip_add_file_to_archive(deark *c, dbuf *f)
+{
+	struct zipw_ctx *zzz;
+	struct zipw_md *md = NULL;
+	struct zipw_cmprjob job;
+
+	zzz = zipw_get_ctx(c);
+	if(!zzz) goto done;
+
+	if(zzz->strm) {
+		zipw_defer_member(c, zzz, f);
+		goto done;
+	}
+
+	de_dbg(c, "adding to zip: name=%s len=%"I64_FMT, f->name, f->len);
+
+	md = zipw_md_create(c, f);
+
+	if(zzz->num_threads>1 && !md->is_directory) {
+		zipw_queue_member(c, zzz, f, md);
+		md = NULL;
+		goto done;
+	}
+	zipw_flush_queue(c, zzz);
+
 	if(md->is_directory) {
 		size_t nlen;
 		char *name2;
@@ -489,58 +945,410 @@ void de_zip_add_file_to_archive(deark *c, dbuf *f)
 		name2 = de_malloc(c, (i64)nlen+2);
 		de_snprintf(name2, nlen+2, "%s/", f->name);
 
-		zipw_add_memberfile(c, zzz, md, f, name2, MZ_NO_COMPRESSION);
+		zipw_cmprjob_init(c, zzz, &job, md, f, name2, MZ_NO_COMPRESSION);
+		zipw_cmprjob_run((void*)&job);
+		zipw_add_memberfile(c, zzz, md, f, name2, &job);
 
 		de_free(c, name2);
 	}
 	else {
-		zipw_add_memberfile(c, zzz, md, f, f->name, zzz->cmprlevel);
+		zipw_cmprjob_init(c, zzz, &job, md, f, f->name, zzz->cmprlevel);
+		zipw_cmprjob_run((void*)&job);
+		zipw_add_memberfile(c, zzz, md, f, f->name, &job);
+		dbuf_close(job.cmpr_data);
 	}
 
 done:
-	if(md) {
-		dbuf_close(md->eflocal);
-		dbuf_close(md->efcentral);
-		de_free(c, md);
+	zipw_md_destroy(c, md);
+}
+
+// Compress the collected blocks of the streamed member file, using multiple
+// threads, and write them to the ZIP file.
+static void zipw_stream_flush_blocks(deark *c, struct zipw_ctx *zzz, u8 is_last)
+{
+	struct zipw_stream *strm = zzz->strm;
+	void *jobs[ZIPW_MAX_THREADS];
+	int i;
+	i64 t0;
+
+	if(is_last && strm->num_blocks_used==0) {
+		// Need at least one block, to finish the Deflate stream
+		strm->num_blocks_used = 1;
+	}
+	if(strm->num_blocks_used==0) return;
+
+	for(i=0; i<strm->num_blocks_used; i++) {
+		strm->blocks[i].is_last_block = (is_last && i==strm->num_blocks_used-1);
+		jobs[i] = (void*)&strm->blocks[i];
+	}
+	t0 = de_get_highres_time_ns();
+	de_run_jobs_in_parallel(c, zipw_blockjob_run, jobs, (i64)strm->num_blocks_used,
+		zzz->num_threads);
+	strm->cmpr_time_ns += de_get_highres_time_ns() - t0;
+
+	for(i=0; i<strm->num_blocks_used; i++) {
+		if(strm->blocks[i].cmpr_failed) {
+			de_err(c, "Deflate compression error");
+			strm->blocks[i].cmpr_failed = 0;
+		}
+		de_crcobj_combine(zzz->crc32o, strm->blocks[i].crc, strm->blocks[i].inf->len);
+		dbuf_copy(strm->blocks[i].cmpr_data, 0, strm->blocks[i].cmpr_data->len,
+			zzz->outf);
+		dbuf_close(strm->blocks[i].cmpr_data);
+		strm->blocks[i].cmpr_data = NULL;
+		dbuf_truncate(strm->blocks[i].inf, 0);
+	}
+	strm->num_blocks_used = 0;
+}
+
+static void zipw_stream_addbuf(struct zipw_ctx *zzz, const u8 *buf, i64 buf_len)
+{
+	struct zipw_stream *strm = zzz->strm;
+
+	if(!strm->blocks) {
+		// (If using blocks, each block's CRC is calculated by its thread.)
+		de_crcobj_addbuf(zzz->crc32o, buf, buf_len);
+	}
+	strm->mbr.uncmpr_len += buf_len;
+	if(strm->tdctx) {
+		i64 t0 = de_get_highres_time_ns();
+
+		fmtutil_tdefl_compress_buffer(strm->tdctx, buf, (size_t)buf_len,
+			FMTUTIL_TDEFL_NO_FLUSH);
+		strm->cmpr_time_ns += de_get_highres_time_ns() - t0;
+	}
+	else if(strm->blocks) {
+		while(buf_len>0) {
+			dbuf *blk;
+			i64 n;
+
+			if(strm->num_blocks_used==0 ||
+				strm->blocks[strm->num_blocks_used-1].inf->len >= ZIPW_BLOCK_SIZE)
+			{
+				if(strm->num_blocks_used >= zzz->num_threads) {
+					zipw_stream_flush_blocks(zzz->c, zzz, 0);
+				}
+				strm->num_blocks_used++;
+			}
+			blk = strm->blocks[strm->num_blocks_used-1].inf;
+			n = de_min_int(buf_len, ZIPW_BLOCK_SIZE - blk->len);
+			dbuf_write(blk, buf, n);
+			buf += n;
+			buf_len -= n;
+		}
+	}
+	else {
+		dbuf_write(zzz->outf, buf, buf_len);
+	}
+}
+
+static void zipw_stream_destroy(deark *c, struct zipw_ctx *zzz)
+{
+	struct zipw_stream *strm = zzz->strm;
+	int i;
+
+	if(!strm) return;
+	fmtutil_tdefl_destroy(strm->tdctx);
+	if(strm->blocks) {
+		for(i=0; i<zzz->num_threads; i++) {
+			dbuf_close(strm->blocks[i].inf);
+			dbuf_close(strm->blocks[i].cmpr_data);
+			de_crcobj_destroy(strm->blocks[i].crco);
+		}
+		de_free(c, strm->blocks);
+	}
+	zipw_md_destroy(c, strm->md);
+	de_free(c, strm);
+	zzz->strm = NULL;
+}
+
+static void zipw_stream_write_cbfn(dbuf *f, void *userdata, const u8 *buf, i64 buf_len)
+{
+	zipw_stream_addbuf((struct zipw_ctx*)userdata, buf, buf_len);
+}
+
+// Called when member file f, a membuf, is getting large. Write its local
+// header now, and from now on, compress its data and write it to the ZIP
+// file as it arrives, so that we don't have to hold it in memory.
+// If we can't do that right now, leave f alone.
+void de_zip_start_streaming_member(deark *c, dbuf *f)
+{
+	struct zipw_ctx *zzz;
+	struct zipw_stream *strm;
+	u8 *mem;
+	i64 memlen;
+	unsigned int level;
+
+	zzz = zipw_get_ctx(c);
+	if(!zzz) return;
+	if(zzz->strm) return; // Already streaming a different file
+
+	// Files that were finished earlier go first.
+	zipw_flush_queue(c, zzz);
+
+	de_dbg(c, "streaming zip member: name=%s", f->name);
+	strm = de_malloc(c, sizeof(struct zipw_stream));
+	strm->md = zipw_md_create(c, f);
+	strm->mbr.ldir_offset = zzz->outf->len;
+
+	strm->stored_reason = ZIPW_STORED_NOT_TRIED;
+	if(zzz->cmprlevel>0) {
+		strm->compress = 1;
+	}
+	if(strm->compress && zzz->cmpr_check) {
+		// We only have the first part of the file to look at, but that
+		// should be enough.
+		if(zipw_is_cmpr_ext(f->name)) {
+			strm->compress = 0;
+			strm->stored_reason = ZIPW_STORED_BY_EXT;
+		}
+		else {
+			i64 t0 = de_get_highres_time_ns();
+
+			if(!zipw_trial_compress(c, f->membuf_buf, f->len)) {
+				strm->compress = 0;
+				strm->stored_reason = ZIPW_STORED_BY_TRIAL;
+			}
+			strm->cmpr_time_ns += de_get_highres_time_ns() - t0;
+		}
 	}
+
+	if(zzz->outf->btype!=DBUF_TYPE_OFILE) {
+		// We won't be able to go back and fill in the sizes and CRC, so
+		// put them in a data descriptor after the data.
+		strm->use_data_descriptor = 1;
+		strm->mbr.bit_flags |= 0x0008;
+	}
+
+	level = zzz->cmprlevel;
+	if(!strm->compress && strm->use_data_descriptor) {
+		// A streaming reader can't find the end of a stored member that has
+		// a data descriptor, and some refuse such members. So use Deflate
+		// with uncompressed blocks instead.
+		strm->compress = 1;
+		strm->deflate_stored = 1;
+		level = 0;
+	}
+
+	if(strm->compress) {
+		strm->mbr.cmpr_meth = 8;
+		strm->mbr.ver_needed = 20;
+		strm->mbr.bit_flags |= zipw_level_to_bit_flags(level);
+		if(zzz->num_threads>1 && !strm->deflate_stored) {
+			int i;
+
+			strm->blocks = de_mallocarray(c, zzz->num_threads,
+				sizeof(struct zipw_blockjob));
+			for(i=0; i<zzz->num_threads; i++) {
+				strm->blocks[i].c = c;
+				strm->blocks[i].level = level;
+				strm->blocks[i].inf = dbuf_create_membuf(c, ZIPW_BLOCK_SIZE, 0);
+				strm->blocks[i].crco = de_crcobj_create(c, DE_CRCOBJ_CRC32_IEEE);
+			}
+		}
+		else {
+			strm->tdctx = fmtutil_tdefl_create(c, zzz->outf,
+				fmtutil_tdefl_create_comp_flags_from_zip_params(level, -15,
+				MZ_DEFAULT_STRATEGY));
+		}
+	}
+	else {
+		strm->mbr.cmpr_meth = 0;
+		strm->mbr.ver_needed = 10;
+	}
+	strm->mbr.bit_flags |= 0x0800; // Use UTF-8 filenames
+
+	// We don't know how big the file will be, and the local header can't
+	// grow later. If it might need ZIP64 sizes, reserve space for them now.
+	// (The compressed size can be slightly larger than the uncompressed size,
+	// so leave some margin.)
+	if(c->max_output_file_size > ZIPW_MAX32 - 0x100000) {
+		strm->mbr.zip64_local = 1;
+	}
+	if(strm->mbr.zip64_local || strm->mbr.ldir_offset >= ZIPW_MAX32) {
+		strm->mbr.ver_needed = 45;
+	}
+
+	zipw_write_local_header(zzz, strm->md, f->name, &strm->mbr);
+	strm->data_start = zzz->outf->len;
+	if(strm->mbr.zip64_local) {
+		strm->zip64_ef_pos = strm->data_start - strm->md->eflocal->len - 16;
+	}
+	de_crcobj_reset(zzz->crc32o);
+	zzz->strm = strm;
+
+	// Convert f to a custom dbuf that sends its data to us.
+	mem = f->membuf_buf;
+	memlen = f->len;
+	f->membuf_buf = NULL;
+	f->membuf_alloc = 0;
+	f->btype = DBUF_TYPE_CUSTOM;
+	f->customwrite_fn = zipw_stream_write_cbfn;
+	f->userdata_for_customwrite = (void*)zzz;
+	f->max_len_hard = c->max_output_file_size;
+	f->write_memfile_to_zip_archive = 0;
+	f->writing_to_zip_stream = 1;
+	f->write_combining = 1;
+
+	zipw_stream_addbuf(zzz, mem, memlen);
+	de_free(c, mem);
 }
 
-static int copy_to_FILE_cbfn(struct de_bufferedreadctx *brctx, const u8 *buf,
-	i64 buf_len)
+static void zipw_patch_u32(struct zipw_ctx *zzz, i64 pos, i64 n)
 {
-	size_t ret;
-	ret = fwrite(buf, 1, (size_t)buf_len, (FILE*)brctx->userdata);
-	return (ret==(size_t)buf_len);
+	u8 buf[4];
+
+	de_writeu32le_direct(buf, n);
+	dbuf_write_at(zzz->outf, pos, buf, 4);
 }
 
-static void dbuf_copy_to_FILE(dbuf *inf, i64 input_offset, i64 input_len, FILE *outfile)
+static void zipw_patch_u64(struct zipw_ctx *zzz, i64 pos, i64 n)
 {
-	dbuf_buffered_read(inf, input_offset, input_len, copy_to_FILE_cbfn, (void*)outfile);
+	u8 buf[8];
+
+	de_writeu64le_direct(buf, (u64)n);
+	dbuf_write_at(zzz->outf, pos, buf, 8);
+}
+
+void de_zip_end_streaming_member(deark *c, dbuf *f)
+{
+	struct zipw_ctx *zzz = (struct zipw_ctx*)c->zip_data;
+	struct zipw_stream *strm;
+
+	if(!zzz || !zzz->strm) return;
+	strm = zzz->strm;
+
+	if(strm->tdctx) {
+		if(fmtutil_tdefl_compress_buffer(strm->tdctx, NULL, 0, FMTUTIL_TDEFL_FINISH) !=
+			FMTUTIL_TDEFL_STATUS_DONE)
+		{
+			de_err(c, "Deflate compression error");
+		}
+		fmtutil_tdefl_destroy(strm->tdctx);
+		strm->tdctx = NULL;
+	}
+	else if(strm->blocks) {
+		zipw_stream_flush_blocks(c, zzz, 1);
+	}
+
+	strm->mbr.crc = de_crcobj_getval(zzz->crc32o);
+	strm->mbr.cmpr_len = zzz->outf->len - strm->data_start;
+	if(!strm->mbr.zip64_local &&
+		(strm->mbr.cmpr_len >= ZIPW_MAX32 || strm->mbr.uncmpr_len >= ZIPW_MAX32))
+	{
+		de_err(c, "Maximum ZIP member file size exceeded");
+	}
+
+	if(strm->use_data_descriptor) {
+		// If the local header has a ZIP64 extra field, the data descriptor
+		// has 8-byte sizes.
+		dbuf_writeu32le(zzz->outf, CODE_PK78);
+		dbuf_writeu32le(zzz->outf, strm->mbr.crc);
+		if(strm->mbr.zip64_local) {
+			dbuf_writeu64le(zzz->outf, (u64)strm->mbr.cmpr_len);
+			dbuf_writeu64le(zzz->outf, (u64)strm->mbr.uncmpr_len);
+		}
+		else {
+			dbuf_writeu32le(zzz->outf, strm->mbr.cmpr_len);
+			dbuf_writeu32le(zzz->outf, strm->mbr.uncmpr_len);
+		}
+	}
+	else {
+		zipw_patch_u32(zzz, strm->mbr.ldir_offset+14, strm->mbr.crc);
+		if(strm->mbr.zip64_local) {
+			zipw_patch_u64(zzz, strm->zip64_ef_pos, strm->mbr.uncmpr_len);
+			zipw_patch_u64(zzz, strm->zip64_ef_pos+8, strm->mbr.cmpr_len);
+		}
+		else {
+			zipw_patch_u32(zzz, strm->mbr.ldir_offset+18, strm->mbr.cmpr_len);
+			zipw_patch_u32(zzz, strm->mbr.ldir_offset+22, strm->mbr.uncmpr_len);
+		}
+	}
+
+	zzz->stats.cmpr_time_ns += strm->cmpr_time_ns;
+	if(strm->compress && !strm->deflate_stored) {
+		zzz->stats.num_compressed++;
+		zzz->stats.uncmpr_bytes_compressed += strm->mbr.uncmpr_len;
+		zzz->stats.cmpr_bytes_compressed += strm->mbr.cmpr_len;
+	}
+	else {
+		zzz->stats.num_stored[strm->stored_reason]++;
+		if(strm->stored_reason!=ZIPW_STORED_NOT_TRIED) {
+			zzz->stats.bytes_stored_by_policy += strm->mbr.uncmpr_len;
+		}
+	}
+
+	zipw_write_cdir_entry(zzz, strm->md, f->name, &strm->mbr);
+	zzz->membercount++;
+	zipw_member_written(zzz);
+
+	zipw_stream_destroy(c, zzz);
+	f->writing_to_zip_stream = 0;
+
+	zipw_flush_pending_members(c, zzz);
 }
 
 static void zipw_finalize(deark *c, struct zipw_ctx *zzz)
 {
 	i64 cdir_start;
+	i64 zip64_eocd_pos;
+	u8 need_zip64;
 
 	cdir_start = zzz->outf->len;
-	if((cdir_start > 0xffffffffLL) || (zzz->cdir->len > 0xffffffffLL)) {
-		de_err(c, "Maximum ZIP file size exceeded");
-		goto done;
-	}
-
 	dbuf_copy(zzz->cdir, 0, zzz->cdir->len, zzz->outf);
 
+	need_zip64 = (zzz->membercount >= ZIPW_MAX16 || cdir_start >= ZIPW_MAX32 ||
+		zzz->cdir->len >= ZIPW_MAX32);
+
+	if(need_zip64) {
+		de_dbg(c, "writing ZIP64 end of central directory");
+		zip64_eocd_pos = zzz->outf->len;
+
+		// 56-byte ZIP64 EOCD record
+		dbuf_writeu32le(zzz->outf, CODE_PK66);
+		dbuf_writeu64le(zzz->outf, 44); // size of the rest of this record
+		dbuf_writeu16le(zzz->outf, (3<<8) | 63); // version made by
+		dbuf_writeu16le(zzz->outf, 45); // version needed
+		dbuf_writeu32le(zzz->outf, 0); // this disk num
+		dbuf_writeu32le(zzz->outf, 0); // central dir disk
+		dbuf_writeu64le(zzz->outf, (u64)zzz->membercount); // num files this disk
+		dbuf_writeu64le(zzz->outf, (u64)zzz->membercount); // num files total
+		dbuf_writeu64le(zzz->outf, (u64)zzz->cdir->len); // central dir size
+		dbuf_writeu64le(zzz->outf, (u64)cdir_start);
+
+		// 20-byte ZIP64 EOCD locator
+		dbuf_writeu32le(zzz->outf, CODE_PK67);
+		dbuf_writeu32le(zzz->outf, 0); // disk with ZIP64 EOCD
+		dbuf_writeu64le(zzz->outf, (u64)zip64_eocd_pos);
+		dbuf_writeu32le(zzz->outf, 1); // total number of disks
+	}
+
 	// Write 22-byte EOCD record
 	dbuf_writeu32le(zzz->outf, CODE_PK56);
 	dbuf_writeu16le(zzz->outf, 0); // this disk num
 	dbuf_writeu16le(zzz->outf, 0); // central dir disk
-	dbuf_writeu16le(zzz->outf, zzz->membercount); // num files this disk
-	dbuf_writeu16le(zzz->outf, zzz->membercount); // num files total
-	dbuf_writeu32le(zzz->outf, zzz->cdir->len); // central dir size
-	dbuf_writeu32le(zzz->outf, cdir_start);
+	dbuf_writeu16le(zzz->outf, de_min_int(zzz->membercount, ZIPW_MAX16)); // num files this disk
+	dbuf_writeu16le(zzz->outf, de_min_int(zzz->membercount, ZIPW_MAX16)); // num files total
+	dbuf_writeu32le(zzz->outf, de_min_int(zzz->cdir->len, ZIPW_MAX32)); // central dir size
+	dbuf_writeu32le(zzz->outf, de_min_int(cdir_start, ZIPW_MAX32));
 	dbuf_writeu16le(zzz->outf, 0); // ZIP comment length
-done:
-	;
+}
+
+static void zipw_report_stats(deark *c, struct zipw_ctx *zzz)
+{
+	struct zipw_stats *st = &zzz->stats;
+
+	de_dbg(c, "zip compression stats:");
+	de_dbg_indent(c, 1);
+	de_dbg(c, "compressed: %"I64_FMT" files, %"I64_FMT" -> %"I64_FMT" bytes",
+		st->num_compressed, st->uncmpr_bytes_compressed, st->cmpr_bytes_compressed);
+	de_dbg(c, "stored: %"I64_FMT" not tried, %"I64_FMT" by extension, %"I64_FMT
+		" by trial, %"I64_FMT" no savings",
+		st->num_stored[ZIPW_STORED_NOT_TRIED], st->num_stored[ZIPW_STORED_BY_EXT],
+		st->num_stored[ZIPW_STORED_BY_TRIAL], st->num_stored[ZIPW_STORED_NO_SAVINGS]);
+	de_dbg(c, "bytes not compressed due to policy: %"I64_FMT, st->bytes_stored_by_policy);
+	de_dbg(c, "compression time: %.3f sec", (double)st->cmpr_time_ns/1000000000.0);
+	de_dbg_indent(c, -1);
 }
 
 void de_zip_close_file(deark *c)
@@ -552,15 +1360,22 @@ void de_zip_close_file(deark *c)
 
 	zzz = (struct zipw_ctx*)c->zip_data;
 
-	zipw_finalize(c, zzz);
+	if(zzz->strm) {
+		de_err(c, "Internal: ZIP member file not closed");
+		zipw_stream_destroy(c, zzz);
+	}
+	zipw_flush_pending_members(c, zzz);
+	zipw_flush_queue(c, zzz);
 
-	if(c->archive_to_stdout && zzz->outf && zzz->outf->btype==DBUF_TYPE_MEMBUF) {
-		dbuf_copy_to_FILE(zzz->outf, 0, zzz->outf->len, stdout);
+	zipw_finalize(c, zzz);
+	if(c->debug_level>=1) {
+		zipw_report_stats(c, zzz);
 	}
 
 	dbuf_close(zzz->cdir);
 	dbuf_close(zzz->outf);
 	de_crcobj_destroy(zzz->crc32o);
+	de_free(c, zzz->queue);
 
 	de_free(c, zzz);
 	c->zip_data = NULL;
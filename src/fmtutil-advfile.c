@@ -120,10 +120,17 @@ static void de_advfile_run_rawfiles(deark *c, struct de_advfile *advf, int is_ap
 		afp_main->whattodo = DE_ADVFILE_WRITEMAIN;
 		de_finfo_set_name_from_ucstring(c, advf->mainfork.fi, advf->filename, advf->snflags);
 		advf->mainfork.fi->original_filename_flag = advf->original_filename_flag;
+		advf->mainfork.fi->len_known = 1;
+		advf->mainfork.fi->len = advf->mainfork.fork_len;
 		afp_main->outf = dbuf_create_output_file(c, NULL, advf->mainfork.fi, advf->createflags);
+		// (The finfo may be reused for an AppleDouble file.)
+		advf->mainfork.fi->len_known = 0;
 		dbuf_set_writelistener(afp_main->outf, advf->mainfork.writelistener_cb,
 			advf->mainfork.userdata_for_writelistener);
-		if(advf->writefork_cbfn && advf->mainfork.fork_len>0) {
+		if(dbuf_is_discarded(afp_main->outf)) {
+			advf->mainfork.write_skipped = 1;
+		}
+		else if(advf->writefork_cbfn && advf->mainfork.fork_len>0) {
 			advf->writefork_cbfn(c, advf, afp_main);
 		}
 		dbuf_close(afp_main->outf);
@@ -135,10 +142,15 @@ static void de_advfile_run_rawfiles(deark *c, struct de_advfile *advf, int is_ap
 		afp_rsrc->whattodo = DE_ADVFILE_WRITERSRC;
 		// Note: It is intentional to use mainfork in the next line.
 		advf->rsrcfork.fi->timestamp[DE_TIMESTAMPIDX_MODIFY] = advf->mainfork.fi->timestamp[DE_TIMESTAMPIDX_MODIFY];
+		advf->rsrcfork.fi->len_known = 1;
+		advf->rsrcfork.fi->len = advf->rsrcfork.fork_len;
 		afp_rsrc->outf = dbuf_create_output_file(c, NULL, advf->rsrcfork.fi, advf->createflags);
 		dbuf_set_writelistener(afp_rsrc->outf, advf->rsrcfork.writelistener_cb,
 			advf->rsrcfork.userdata_for_writelistener);
-		if(advf->writefork_cbfn) {
+		if(dbuf_is_discarded(afp_rsrc->outf)) {
+			advf->rsrcfork.write_skipped = 1;
+		}
+		else if(advf->writefork_cbfn) {
 			advf->writefork_cbfn(c, advf, afp_rsrc);
 		}
 		dbuf_close(afp_rsrc->outf);
@@ -205,6 +217,13 @@ static void de_advfile_run_applesd(deark *c, struct de_advfile *advf, int is_app
 	de_finfo_set_name_from_ucstring(c, advf->mainfork.fi, fname, advf->snflags);
 	advf->mainfork.fi->original_filename_flag = advf->original_filename_flag;
 	outf = dbuf_create_output_file(c, NULL, advf->mainfork.fi, advf->createflags);
+	if(dbuf_is_discarded(outf)) {
+		advf->rsrcfork.write_skipped = 1;
+		if(!is_appledouble) {
+			advf->mainfork.write_skipped = 1;
+		}
+		goto done;
+	}
 
 	if(is_appledouble) { // signature
 		dbuf_writeu32be(outf, 0x00051607U);
@@ -461,6 +480,11 @@ static void de_advfile_run_macbinary(deark *c, struct de_advfile *advf)
 
 	dbuf_truncate(hdr, 128);
 	outf = dbuf_create_output_file(c, NULL, advf->mainfork.fi, advf->createflags);
+	if(dbuf_is_discarded(outf)) {
+		advf->mainfork.write_skipped = 1;
+		advf->rsrcfork.write_skipped = 1;
+		goto done;
+	}
 	dbuf_copy(hdr, 0, 128, outf);
 
 	afp_main = de_malloc(c, sizeof(struct de_advfile_cbparams));
@@ -500,6 +524,8 @@ void de_advfile_run(struct de_advfile *advf)
 	int is_mac_file;
 	int fmt;
 
+	advf->mainfork.write_skipped = 0;
+	advf->rsrcfork.write_skipped = 0;
 	is_mac_file = (advf->rsrcfork.fork_exists && advf->rsrcfork.fork_len>0);
 
 	if(is_mac_file && !c->macformat_known) {
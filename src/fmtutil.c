@@ -791,10 +791,13 @@ static int decode_atari_image_paletted(deark *c, struct atari_img_decode_data *a
 	i64 i, j;
 	i64 plane;
 	i64 rowspan;
-	u8 b;
 	u32 v;
 	i64 planespan;
 	i64 ncolors;
+	u8 *rawbuf = NULL; // The current row, as stored
+	u8 *planebuf = NULL; // One plane of the current row, one byte per pixel
+	u32 *vbuf = NULL; // The current row's palette indices
+	u32 *clrbuf = NULL;
 
 	planespan = 2*((adata->w+15)/16);
 	rowspan = planespan*adata->bpp;
@@ -803,38 +806,37 @@ static int decode_atari_image_paletted(deark *c, struct atari_img_decode_data *a
 	else
 		ncolors = ((i64)1)<<adata->bpp;
 
+	if(!de_good_image_dimensions_noerr(c, adata->w, adata->h)) goto done;
+	rawbuf = de_malloc(c, rowspan);
+	planebuf = de_malloc(c, planespan*8);
+	vbuf = de_mallocarray(c, adata->w, sizeof(vbuf[0]));
+	clrbuf = de_mallocarray(c, adata->w, sizeof(clrbuf[0]));
+
 	for(j=0; j<adata->h; j++) {
-		for(i=0; i<adata->w; i++) {
-			v = 0;
-
-			for(plane=0; plane<adata->bpp; plane++) {
-				if(adata->was_compressed==0) {
-					// TODO: Simplify this.
-					if(adata->bpp==1) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1, j*rowspan, i);
-					}
-					else if(adata->bpp==2) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i/16)*2, i);
-					}
-					else if(adata->bpp==4) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i/2-(i/2)%16)+8*((i%32)/16), i%16);
-					}
-					else if(adata->bpp==8) {
-						b = de_get_bits_symbol(adata->unc_pixels, 1,
-							j*rowspan + 2*plane + (i-i%16), i%16);
-					}
-					else {
-						b = 0;
-					}
-				}
-				else {
-					b = de_get_bits_symbol(adata->unc_pixels, 1, j*rowspan + plane*planespan, i);
+		dbuf_read(adata->unc_pixels, rawbuf, j*rowspan, rowspan);
+		de_zeromem(vbuf, (size_t)adata->w * sizeof(vbuf[0]));
+
+		for(plane=0; plane<adata->bpp; plane++) {
+			if(adata->was_compressed==0) {
+				i64 wordnum;
+
+				// The planes are interleaved, one 16-bit word (16 pixels) at a time.
+				for(wordnum=0; wordnum<planespan/2; wordnum++) {
+					de_unpack_pixels(&rawbuf[(wordnum*adata->bpp + plane)*2], 1, 16,
+						&planebuf[wordnum*16], 0);
 				}
-				if(b) v |= 1<<plane;
+			}
+			else {
+				de_unpack_pixels(&rawbuf[plane*planespan], 1, planespan*8, planebuf, 0);
 			}
 
+			for(i=0; i<adata->w; i++) {
+				vbuf[i] |= (u32)planebuf[i]<<(UI)plane;
+			}
+		}
+
+		for(i=0; i<adata->w; i++) {
+			v = vbuf[i];
 			if(adata->is_spectrum512) {
 				v = spectrum512_FindIndex(i, v);
 				if(j>0) {
@@ -842,10 +844,17 @@ static int decode_atari_image_paletted(deark *c, struct atari_img_decode_data *a
 				}
 			}
 			if(v>=(unsigned int)ncolors) v=(unsigned int)(ncolors-1);
-
-			de_bitmap_setpixel_rgb(adata->img, i, j, adata->pal[v]);
+			clrbuf[i] = adata->pal[v];
 		}
+
+		de_bitmap_setpixels_rgba(adata->img, 0, j, adata->w, clrbuf);
 	}
+
+done:
+	de_free(c, rawbuf);
+	de_free(c, planebuf);
+	de_free(c, vbuf);
+	de_free(c, clrbuf);
 	return 1;
 }
 
@@ -853,17 +862,26 @@ static int decode_atari_image_16(deark *c, struct atari_img_decode_data *adata)
 {
 	i64 i, j;
 	i64 rowspan;
-	u32 v;
+	u8 *rawbuf = NULL;
+	u32 *clrbuf = NULL;
 
 	rowspan = adata->w * 2;
 
+	if(!de_good_image_dimensions_noerr(c, adata->w, adata->h)) goto done;
+	rawbuf = de_malloc(c, rowspan);
+	clrbuf = de_mallocarray(c, adata->w, sizeof(clrbuf[0]));
+
 	for(j=0; j<adata->h; j++) {
+		dbuf_read(adata->unc_pixels, rawbuf, j*rowspan, rowspan);
 		for(i=0; i<adata->w; i++) {
-			v = (u32)dbuf_getu16be(adata->unc_pixels, j*rowspan + 2*i);
-			v = de_rgb565_to_888(v);
-			de_bitmap_setpixel_rgb(adata->img, i, j,v);
+			clrbuf[i] = de_rgb565_to_888((u32)de_getu16be_direct(&rawbuf[2*i]));
 		}
+		de_bitmap_setpixels_rgba(adata->img, 0, j, adata->w, clrbuf);
 	}
+
+done:
+	de_free(c, rawbuf);
+	de_free(c, clrbuf);
 	return 1;
 }
 
@@ -1370,6 +1388,91 @@ done:
 	return retval;
 }
 
+// Figure out the length of a JPEG or JPEG-LS stream starting at pos1 (which
+// should be the position of the SOI marker), by walking its markers until EOI.
+// Returns 0 if it doesn't seem to be a valid stream within the given 'len'
+// bytes.
+int de_fmtutil_detect_jpeg_len(deark *c, dbuf *f, i64 pos1, i64 len,
+	i64 *pjpeglen, u8 *pis_jpegls)
+{
+	u8 b0, b1;
+	i64 pos;
+	i64 seg_size;
+	int in_scan = 0;
+	int found_sof = 0;
+	int found_scan = 0;
+
+	*pjpeglen = 0;
+	*pis_jpegls = 0;
+	pos = pos1;
+
+	while(1) {
+		if(pos>=pos1+len)
+			break;
+		b0 = dbuf_getbyte(f, pos);
+
+		if(b0!=0xff) {
+			pos++;
+			continue;
+		}
+
+		// Peek at the next byte (after this 0xff byte).
+		b1 = dbuf_getbyte(f, pos+1);
+
+		if(b1==0xff) {
+			// A "fill byte", not a marker.
+			pos++;
+			continue;
+		}
+		else if(b1==0x00 || (*pis_jpegls && b1<0x80 && in_scan)) {
+			// An escape sequence, not a marker.
+			pos+=2;
+			continue;
+		}
+		else if(b1==0xd9) { // EOI. That's what we're looking for.
+			if(!found_sof || !found_scan) return 0;
+			pos+=2;
+			*pjpeglen = pos-pos1;
+			return 1;
+		}
+		else if(b1==0xf7) {
+			de_dbg(c, "Looks like a JPEG-LS file.");
+			found_sof = 1;
+			*pis_jpegls = 1;
+		}
+		else if(b1>=0xc0 && b1<=0xcf && b1!=0xc4 && b1!=0xc8 && b1!=0xcc) {
+			found_sof = 1;
+		}
+
+		if(b1==0xda) { // SOS - Start of scan
+			if(!found_sof) return 0;
+			found_scan = 1;
+			in_scan = 1;
+		}
+		else if(b1>=0xd0 && b1<=0xd7) {
+			// RSTn markers don't change the in_scan state.
+			;
+		}
+		else {
+			in_scan = 0;
+		}
+
+		if((b1>=0xd0 && b1<=0xda) || b1==0x01) {
+			// Markers that have no content.
+			pos+=2;
+			continue;
+		}
+
+		// Everything else should be a marker segment, with a length field.
+		seg_size = dbuf_getu16be(f, pos+2);
+		if(seg_size<2) break; // bogus size
+
+		pos += seg_size+2;
+	}
+
+	return 0;
+}
+
 // Quick & dirty encoder that can wrap some formats in a TIFF container.
 static void wrap_in_tiff(deark *c, dbuf *f, i64 dpos, i64 dlen,
 	const char *swstring, unsigned int tag, const char *ext, unsigned int createflags)